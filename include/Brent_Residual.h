@@ -0,0 +1,37 @@
+#ifndef BRENT_RESIDUAL_H
+#define BRENT_RESIDUAL_H
+
+#include <vector>
+#include <armadillo>
+
+
+/**
+    Residual of the Brent equations of a bilinear matrix multiplication scheme
+
+        E(c,a,b) = sum_r W_2(c,r) W_1A(r,a) W_1B(r,b) - T(c,a,b)
+
+    with a, b, c the (column-major) indices of vectorise(A), vectorise(B)
+    and vectorise(A*B), and T the matrix multiplication tensor.
+    The scheme is exact if and only if E vanishes.
+*/
+class Brent_Residual
+{
+    public:
+        Brent_Residual(const std::vector<int>& matrix_dimensions,
+                       const arma::mat& W_1A,
+                       const arma::mat& W_1B,
+                       const arma::mat& W_2);
+
+        ~Brent_Residual(){}
+
+        /// slice b holds E(c,a,b) for all c (rows) and a (columns)
+        const arma::cube& get_residual() const { return E; }
+
+        double squared_norm() const;
+        bool is_exact(double tolerance=1e-12) const;
+
+    private:
+        arma::cube E;
+};
+
+#endif // BRENT_RESIDUAL_H
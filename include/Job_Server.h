@@ -0,0 +1,77 @@
+#ifndef JOB_SERVER_H
+#define JOB_SERVER_H
+
+#include <map>
+#include <set>
+#include <queue>
+#include <mutex>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+#include <iostream>
+#include <condition_variable>
+
+class Strassen_NN;
+class Result_Sink;
+
+
+/**
+    Long-lived training service.
+
+    Jobs are JSON objects, one per line, e.g.
+
+        {"id": "a1", "matrix_dimensions": [2,2,2], "rank": 7, "epochs": 100,
+         "train": 10000, "test": 1000, "learning_rate": 1e-2, "reg_param": 0,
+         "scale_factor": 1, "seed": 3, "threshold_eout": 1e-8, "refine": 0}
+
+    Omitted fields take the defaults of the command line. Jobs run on a
+    fixed pool of worker threads; each worker keeps its networks allocated
+    across jobs of the same shape and rank. One JSON result line is
+    written back per job, in order of completion.
+*/
+class Job_Server
+{
+    public:
+        Job_Server(int num_threads=0);
+        ~Job_Server();
+
+        /// jobs from a stream (e.g. stdin), returns after all jobs are done
+        void serve_stream(std::istream& in, std::ostream& out);
+
+        /// jobs from connections to a Unix domain socket, runs until accept fails.
+        /// An existing file at socket_path is only replaced if it is a socket.
+        void serve_socket(const std::string& socket_path);
+
+    private:
+
+        struct Job
+        {
+            std::string line;
+            std::shared_ptr<Result_Sink> sink;
+        };
+
+        typedef std::map<std::string, std::unique_ptr<Strassen_NN>> Network_Cache;
+
+        void submit(const std::string& line, const std::shared_ptr<Result_Sink>& sink);
+        void work();
+        std::string process(const std::string& line, Network_Cache& networks) const;
+
+        void read_connection(size_t id, int fd);
+        void stop_readers();
+
+        std::queue<Job> jobs;
+        std::mutex jobs_mutex;
+        std::condition_variable jobs_available;
+        bool stopping = false;
+
+        std::vector<std::thread> workers;
+
+        /// one reader thread per connection, joined once it has finished
+        std::mutex readers_mutex;
+        std::map<size_t, std::thread> readers;
+        std::vector<size_t> finished_readers;
+        std::set<int> open_connections;
+};
+
+#endif // JOB_SERVER_H
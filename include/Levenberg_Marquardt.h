@@ -0,0 +1,41 @@
+#ifndef LEVENBERG_MARQUARDT_H
+#define LEVENBERG_MARQUARDT_H
+
+#include <vector>
+#include <armadillo>
+
+
+/**
+    Levenberg-Marquardt minimization of the squared Brent residual,
+    see Brent_Residual, starting from given weights.
+
+    The residual E(c,a,b) depends on W_1A(:,a), W_1B(:,b) and W_2(c,:) only,
+    so each row of the Jacobian has 3*rank nonzeros. The damped normal
+    equations are solved by preconditioned conjugate gradients on the
+    sparse Jacobian, without forming J^T J.
+*/
+class Levenberg_Marquardt
+{
+    public:
+        Levenberg_Marquardt(const std::vector<int>& matrix_dimensions,
+                            double lambda=1e-3,
+                            size_t cg_iterations=200);
+
+        ~Levenberg_Marquardt(){}
+
+        /// returns the squared residual of the polished weights
+        double polish(arma::mat& W_1A, arma::mat& W_1B, arma::mat& W_2, size_t max_iterations, double tolerance=1e-24);
+
+    private:
+
+        arma::sp_mat jacobian(const arma::mat& W_1A, const arma::mat& W_1B, const arma::mat& W_2) const;
+
+        /// solves (J^T J + lambda diag(d)) x = rhs
+        arma::vec conjugate_gradient(const arma::sp_mat& J, const arma::sp_mat& J_t, const arma::vec& d, double lambda, const arma::vec& rhs) const;
+
+        std::vector<int> matrix_dimensions;
+        double initial_lambda;
+        size_t cg_iterations;
+};
+
+#endif // LEVENBERG_MARQUARDT_H
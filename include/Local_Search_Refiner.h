@@ -0,0 +1,75 @@
+#ifndef LOCAL_SEARCH_REFINER_H
+#define LOCAL_SEARCH_REFINER_H
+
+#include <vector>
+#include <armadillo>
+
+
+/**
+    Tabu search over integer coefficients in {-1, 0, 1}, minimizing the
+    squared Brent residual of a (rounded) scheme.
+
+    Every move changes a single coefficient of W_1A, W_1B or W_2. Its
+    effect on the residual is evaluated incrementally, touching only the
+    residual entries that depend on that coefficient.
+*/
+class Local_Search_Refiner
+{
+    public:
+        Local_Search_Refiner(const std::vector<int>& matrix_dimensions,
+                             const arma::mat& W_1A,
+                             const arma::mat& W_1B,
+                             const arma::mat& W_2,
+                             int num_threads=0,
+                             size_t tabu_tenure=0);
+
+        ~Local_Search_Refiner(){}
+
+        bool run(size_t max_iterations);
+
+        /// best point found so far
+        double get_loss() const { return best_loss; }
+        const arma::mat& get_W_1A() const { return best_W_1A; }
+        const arma::mat& get_W_1B() const { return best_W_1B; }
+        const arma::mat& get_W_2() const { return best_W_2; }
+
+    private:
+
+        struct Move
+        {
+            size_t coefficient;
+            double value;
+            double delta;
+        };
+
+        /// coefficients are numbered through W_1A, W_1B and W_2 (column-major)
+        int decode(size_t coefficient, arma::uword& row, arma::uword& col) const;
+        double value_of(size_t coefficient) const;
+
+        double evaluate_move(size_t coefficient, double value) const;
+        void apply_move(size_t coefficient, double value);
+
+        Move best_move(size_t first, size_t last, size_t iteration) const;
+
+        int num_threads;
+        size_t tabu_tenure;
+
+        /// current point
+        arma::mat W_1A;
+        arma::mat W_1B;
+        arma::mat W_2;
+
+        /// residual of current point, see Brent_Residual
+        arma::cube E;
+        double loss;
+
+        /// iteration until which a coefficient must not be changed
+        std::vector<size_t> tabu_until;
+
+        arma::mat best_W_1A;
+        arma::mat best_W_1B;
+        arma::mat best_W_2;
+        double best_loss;
+};
+
+#endif // LOCAL_SEARCH_REFINER_H
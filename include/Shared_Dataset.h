@@ -0,0 +1,75 @@
+#ifndef SHARED_DATASET_H
+#define SHARED_DATASET_H
+
+#include <vector>
+#include <string>
+#include <memory>
+#include <armadillo>
+
+
+/**
+    Read-only, memory-mapped set of samples (A, B, A*B) for one matrix shape
+    and data range. The file is written once and then mapped by every run and
+    worker process, so all of them train on the same data without generating
+    or copying it.
+
+    File layout: 64 byte header, then per sample vec(A), vec(B), vec(A*B)
+    as doubles.
+*/
+class Shared_Dataset
+{
+    public:
+        Shared_Dataset(const std::string& file_name);
+        ~Shared_Dataset();
+
+        Shared_Dataset(const Shared_Dataset&) = delete;
+        Shared_Dataset& operator=(const Shared_Dataset&) = delete;
+
+        /// one file per shape, size, scale and seed, so a different size is never mistaken for a cached one
+        static std::string file_name(const std::string& directory, const std::vector<int>& matrix_dimensions,
+                                     size_t size, double scale, unsigned long long seed);
+
+        /// elements uniformly distributed in [-scale, scale]
+        static void generate(const std::string& file_name,
+                             const std::vector<int>& matrix_dimensions,
+                             size_t size,
+                             double scale,
+                             unsigned long long seed=0);
+
+        /// map the dataset in directory, generating it first if it does not exist yet
+        static std::shared_ptr<const Shared_Dataset> open(const std::string& directory,
+                                                          const std::vector<int>& matrix_dimensions,
+                                                          size_t size,
+                                                          double scale,
+                                                          unsigned long long seed=0);
+
+        size_t size() const { return num_samples; }
+        double get_scale() const { return scale; }
+        const std::vector<int>& get_matrix_dimensions() const { return matrix_dimensions; }
+
+        /// vec(A), followed by vec(B) and vec(A*B)
+        const double* sample(size_t i) const { return samples + i*sample_size; }
+
+    private:
+
+        struct Header
+        {
+            char magic[8];
+            int m, n, k;
+            int reserved;
+            unsigned long long num_samples;
+            double scale;
+            char padding[24];
+        };
+
+        std::vector<int> matrix_dimensions;
+        size_t num_samples;
+        double scale;
+        size_t sample_size;
+
+        void* mapping;
+        size_t mapping_size;
+        const double* samples;
+};
+
+#endif // SHARED_DATASET_H
@@ -2,8 +2,15 @@
 #define STRASSEN_NN_H
 
 #include <vector>
+#include <memory>
+#include <functional>
 #include <armadillo>
 
+class Warm_Start;
+class Weight_Tying;
+class Shared_Dataset;
+class Worker_Pool;
+
 
 class Strassen_NN
 {
@@ -24,36 +31,118 @@ class Strassen_NN
 
         ~Strassen_NN(){}
 
+        /// range of training data, see run(), shared datasets are generated with it
+        static constexpr double training_range = 2.0;
+
+        void reconfigure(size_t training_size,
+                         size_t test_size,
+                         int seed_num,
+                         size_t epochs,
+                         double learning_rate,
+                         double regularization_parameter,
+                         double range_scale_factor,
+                         double threshold_error_out);
+
         double forward_propagation(const arma::mat&, const arma::mat&);
+        double forward_propagation(const arma::mat& A, const arma::mat& B, const arma::mat& C);
         void backward_propagation();
 
         void update_weight_matrices();
+        void update_weight_matrices(const arma::mat& dW_1A, const arma::mat& dW_1B, const arma::mat& dW_2);
+        void update_tied_weights(const arma::vec& d_theta);
         void adam_optimization(const arma::vec& delta, const arma::vec& x, arma::mat& W, arma::mat& v_dW, arma::mat& S_dW);
+        void adam_optimization(const arma::mat& dW, arma::mat& W, arma::mat& v_dW, arma::mat& S_dW);
         void momentum(const arma::vec& delta, const arma::vec& x, arma::mat& W, arma::mat& v_dW);
+        void momentum(const arma::mat& dW, arma::mat& W, arma::mat& v_dW);
+
+        /// closed-form expected loss over the training distribution and its gradient
+        double expected_loss(arma::mat& dW_1A, arma::mat& dW_1B, arma::mat& dW_2) const;
 
         void initialize_weight_matrices();
         void set_optimal_weights_2_2_2();
         void set_near_optimal_weights_2_2_2();
 
         void set_epochs(int); /// to try a second, warm start
+        void warm_start(const Warm_Start&, int epochs=0);
+        void set_pipelined(bool); /// overlap data generation, evaluation and saving with training
+        void set_expected_loss(size_t steps_per_epoch);
+        void set_polishing(size_t window, double tolerance=1e-3, size_t iterations=50);
+        void set_data_parallel(int num_threads, size_t batch_size); /// batch size 0: per-sample updates
+        void set_symmetry(const std::string& symmetry, int num_invariant=-1); /// see Weight_Tying
+        void set_datasets(std::shared_ptr<const Shared_Dataset> training, std::shared_ptr<const Shared_Dataset> test);
+        void set_rank_annealing(double group_sparsity, double prune_threshold, int min_rank=1);
 
         void run();
         double test_out_of_sample();
 
+        /// discrete refinement of the rounded weights, see Local_Search_Refiner
+        bool refine(size_t max_iterations, int num_threads=0);
+
         /// utilities
         void expand_data_range(arma::cube& A, arma::cube& B, double scale, double upper_matrix_element_magnitude_boundary);
         void expand_data_range(arma::cube& A, arma::cube& B, double scale=1.0);
 
         void display_weight_matrices() const;
 
+        const arma::mat& get_W_1A() const { return W_1A; }
+        const arma::mat& get_W_1B() const { return W_1B; }
+        const arma::mat& get_W_2() const { return W_2; }
+        const arma::vec& get_in_sample_error() const { return in_sample_error; }
+        const arma::vec& get_out_sample_error() const { return out_sample_error; }
+        double get_training_time() const { return training_seconds; } /// seconds in data-parallel epochs
+
         void save_info() const;
 
         void save_data(int);
         void save_errors() const;
         void save_weights(int);
+        void save_weights(int, const arma::mat& W1A, const arma::mat& W1B, const arma::mat& W2) const;
+        void save_weights(const std::string& tag, const arma::mat& W1A, const arma::mat& W1B, const arma::mat& W2) const;
 
     private:
 
+        /// epoch schedules
+        void run_sequential();
+        void run_pipelined();
+
+        double train_epoch(const arma::cube& A, const arma::cube& B);
+        double train_epoch(const Shared_Dataset& data, const arma::uvec& order);
+        double train_expected_loss(size_t steps);
+
+        /// synchronous data-parallel mini-batches
+        struct Gradient
+        {
+            arma::mat dW_1A;
+            arma::mat dW_1B;
+            arma::mat dW_2;
+            double loss;
+        };
+
+        void accumulate_gradient(const arma::mat& A, const arma::mat& B, const arma::mat& C, Gradient& g) const;
+        double train_epoch_parallel(size_t num_samples, const std::function<void(size_t, Gradient&)>& accumulate);
+        void round_weights();
+        void reset_optimizer_state();
+        bool should_save(size_t epoch) const;
+
+        /// symmetric weights
+        void tie_weights();
+
+        /// Levenberg-Marquardt polishing
+        bool plateaued(size_t epoch, double e_in) const;
+        void polish(size_t epoch);
+
+        /// rank annealing
+        void shrink_hidden_units();
+        int prune_hidden_units();
+        void remove_hidden_unit(arma::uword r);
+
+        /// pipelined mode
+        void generate_data(arma::cube& A, arma::cube& B, size_t size, double scale, unsigned long long stream);
+        double evaluate(const arma::mat& W1A, const arma::mat& W1B, const arma::mat& W2, const arma::cube& A, const arma::cube& B) const;
+        double evaluate(const arma::mat& W1A, const arma::mat& W1B, const arma::mat& W2, const Shared_Dataset& data, const arma::uvec& order) const;
+        arma::uvec permutation(size_t count, size_t size, unsigned long long stream) const;
+        void evaluate_snapshot(size_t epoch, arma::mat W1A, arma::mat W1B, arma::mat W2);
+
         ///dimensions
         std::vector<int> matrix_dimensions;
         int rank_estimate;
@@ -63,6 +152,18 @@ class Strassen_NN
         size_t training_size;
         size_t test_size;
 
+        bool pipelined = false;
+        size_t expected_loss_steps = 0;
+
+        std::shared_ptr<Worker_Pool> pool;
+        size_t batch_size = 0;
+        double training_seconds = 0.0;
+
+        size_t polish_window = 0;
+        double polish_tolerance = 1e-3;
+        size_t polish_iterations = 50;
+        size_t last_polish = 0;
+
         static constexpr double epsilon = 1e-8;
         static constexpr double beta_1 = 0.9;
         static constexpr double beta_2 = 0.999;
@@ -77,6 +178,15 @@ class Strassen_NN
         double threshold_error_out;
         double range_scale_factor;
 
+        /// rank annealing
+        double group_sparsity = 0.0;
+        double prune_threshold = 0.0;
+        int min_rank = 1;
+
+
+        /// shared samples, generated per epoch if not set
+        std::shared_ptr<const Shared_Dataset> training_data;
+        std::shared_ptr<const Shared_Dataset> test_data;
 
         /// data locations
         std::string data_series_path;
@@ -116,9 +226,15 @@ class Strassen_NN
         arma::mat S_dW_1A;
         arma::mat S_dW_1B;
 
+        /// shared parameters of symmetric weights
+        std::shared_ptr<Weight_Tying> tying;
+        arma::vec theta;
+        arma::vec v_d_theta;
+
         /// errors
         arma::vec in_sample_error;
         arma::vec out_sample_error;
+        arma::vec rank_history;
 };
 
 #endif // STRASSEN_NN_H
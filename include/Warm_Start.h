@@ -0,0 +1,75 @@
+#ifndef WARM_START_H
+#define WARM_START_H
+
+#include <vector>
+#include <string>
+#include <random>
+#include <armadillo>
+
+
+/**
+    A weight set (W_1A, W_1B, W_2) for <m,n,k> matrix multiplication,
+    used as starting point of a training run.
+
+    Weight sets are loaded from the files written by Strassen_NN::save_weights,
+    and can be perturbed, mapped by symmetries of the matrix multiplication
+    tensor, or extended to larger matrix dimensions.
+*/
+class Warm_Start
+{
+    public:
+        Warm_Start(const std::vector<int>& matrix_dimensions,
+                   const arma::mat& W_1A,
+                   const arma::mat& W_1B,
+                   const arma::mat& W_2,
+                   unsigned long long seed=0);
+
+        ~Warm_Start(){}
+
+        /// e.g. load("DATA .../exp_id_0/", "epoch120") reads W1A_epoch120.dat etc.
+        static Warm_Start load(const std::string& path, const std::string& tag, unsigned long long seed=0);
+
+        /// <m1,n1,k1;R1> x <m2,n2,k2;R2> -> <m1m2,n1n2,k1k2;R1R2>
+        static Warm_Start kronecker(const Warm_Start& first, const Warm_Start& second);
+
+        bool is_exact() const;
+
+        /// throws if a file cannot be written
+        void save(const std::string& path, const std::string& tag) const;
+
+        void set_seed(unsigned long long);
+
+        /// perturbations
+        void add_noise(double standard_deviation);
+        void flip_coefficients(double probability);
+
+        /// symmetries, exact schemes stay exact
+        void permute_products();
+        void flip_signs();
+        void transform(const arma::mat& P, const arma::mat& Q, const arma::mat& R);
+        void random_transform();
+        void transpose();
+
+        /// <m,n,k;R> -> <m',n',k';R + m'n'k' - mnk> for m' >= m, n' >= n, k' >= k
+        void extend(const std::vector<int>& new_dimensions);
+
+        const std::vector<int>& get_matrix_dimensions() const { return matrix_dimensions; }
+        int get_rank() const { return W_1A.n_rows; }
+        const arma::mat& get_W_1A() const { return W_1A; }
+        const arma::mat& get_W_1B() const { return W_1B; }
+        const arma::mat& get_W_2() const { return W_2; }
+
+    private:
+
+        arma::mat random_signed_permutation(int size);
+
+        std::vector<int> matrix_dimensions;
+
+        arma::mat W_1A;
+        arma::mat W_1B;
+        arma::mat W_2;
+
+        std::mt19937_64 engine;
+};
+
+#endif // WARM_START_H
@@ -0,0 +1,80 @@
+#ifndef WEIGHT_TYING_H
+#define WEIGHT_TYING_H
+
+#include <vector>
+#include <string>
+#include <armadillo>
+
+
+/**
+    Generates W_1A, W_1B and W_2 of a square <n,n,n> network from a smaller
+    parameter vector theta, such that the scheme is invariant under a symmetry
+    of the matrix multiplication tensor  tr(A B X) = sum A_ij B_jl X_li.
+
+    cyclic (Z3):   (u,v,w) -> (v,w,u).
+                   rank = invariant + 3*orbits, invariant products have u = v = w.
+    transpose:     (u,v,w) -> (w^T,v^T,u^T).
+                   rank = invariant + 2*orbits, invariant products have w = u^T, v = v^T.
+
+    Here u, v, w are the linear forms of a product on A, B and X, and the
+    output row of W_2 for C(i,l) is w at X(l,i).
+
+    vec(W) = G theta for each weight matrix. Every weight is generated by
+    exactly one parameter, so G is kept as the parameter index of each weight
+    and gradients are accumulated into theta by scattering along it.
+*/
+class Weight_Tying
+{
+    public:
+        enum Symmetry { none, cyclic, transpose };
+
+        Weight_Tying(const std::vector<int>& matrix_dimensions,
+                     int rank,
+                     Symmetry symmetry,
+                     int num_invariant=-1);
+
+        ~Weight_Tying(){}
+
+        static Symmetry parse(const std::string& name);
+
+        size_t num_parameters() const { return multiplicity.n_elem; }
+
+        void expand(const arma::vec& theta, arma::mat& W_1A, arma::mat& W_1B, arma::mat& W_2) const;
+        arma::vec gradient(const arma::mat& dW_1A, const arma::mat& dW_1B, const arma::mat& dW_2) const;
+
+        /// gradient of rank-1 updates dW = delta x^T, without forming dW
+        arma::vec gradient(const arma::vec& delta_1A, const arma::vec& x_0A,
+                           const arma::vec& delta_1B, const arma::vec& x_0B,
+                           const arma::vec& delta_2, const arma::vec& x_1) const;
+
+        /// average over tied entries, i.e. closest symmetric weights in the least squares sense
+        arma::vec project(const arma::mat& W_1A, const arma::mat& W_1B, const arma::mat& W_2) const;
+
+    private:
+
+        /// a block of n*n parameters, optionally symmetric (n(n+1)/2 parameters)
+        struct Block
+        {
+            size_t offset;
+            bool symmetric;
+        };
+
+        Block new_block(bool symmetric=false);
+        size_t parameter(const Block& block, arma::uword index, bool transposed) const;
+
+        void add_product(int r, const Block& u, bool u_t, const Block& v, bool v_t, const Block& w, bool w_t);
+
+        int n;
+        int rank;
+        size_t num_params = 0;
+
+        /// parameter of each weight, column-major
+        arma::uvec parameter_1A;
+        arma::uvec parameter_1B;
+        arma::uvec parameter_2;
+
+        /// number of weights generated by each parameter
+        arma::vec multiplicity;
+};
+
+#endif // WEIGHT_TYING_H
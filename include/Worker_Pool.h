@@ -0,0 +1,51 @@
+#ifndef WORKER_POOL_H
+#define WORKER_POOL_H
+
+#include <mutex>
+#include <exception>
+#include <thread>
+#include <vector>
+#include <functional>
+#include <condition_variable>
+
+
+/**
+    Fixed set of threads running one task at a time, fork-join style.
+    run(task) calls task(t) once for every t in [0, size()), the calling
+    thread takes t = 0, and returns after all of them have finished.
+    An exception thrown by any of them is rethrown by run(), after that.
+*/
+class Worker_Pool
+{
+    public:
+        Worker_Pool(int num_threads);
+        ~Worker_Pool();
+
+        Worker_Pool(const Worker_Pool&) = delete;
+        Worker_Pool& operator=(const Worker_Pool&) = delete;
+
+        void run(const std::function<void(int)>& task);
+
+        int size() const { return num_threads; }
+
+    private:
+
+        void work(int t);
+
+        int num_threads;
+        std::vector<std::thread> threads;
+
+        std::mutex pool_mutex;
+        std::condition_variable task_ready;
+        std::condition_variable task_done;
+
+        const std::function<void(int)>* task = nullptr;
+        size_t generation = 0;
+        int pending = 0;
+        bool stopping = false;
+
+        /// first exception of a worker thread in the current task
+        std::exception_ptr worker_error;
+};
+
+#endif // WORKER_POOL_H
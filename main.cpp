@@ -1,13 +1,19 @@
 #include <iostream>
 #include <vector>
+#include <map>
 #include <cmath>
 #include <armadillo>
 #include <iomanip>
 #include <ctime>
 #include <chrono>
+#include <thread>
 #include <experimental/filesystem>
 #include <boost/program_options.hpp>
 #include "Strassen_NN.h"
+#include "Warm_Start.h"
+#include "Job_Server.h"
+#include "Weight_Tying.h"
+#include "Shared_Dataset.h"
 
 
 using namespace std;
@@ -30,6 +36,51 @@ void help()
     cout << endl << "Try 'snn -h' or 'snn --help' for more information.\n\n" << endl;
 }
 
+/**
+ *  time one epoch of synchronous data-parallel training for 1 up to all cores,
+ *  and check that two runs with the same thread count agree bitwise.
+ *  Data generation, evaluation and rounding are not timed.
+ */
+void scaling_report(vector<int>& matrix_dimensions, int rank_estimate, int training_size, int test_size, int batch_size, int seed_num)
+{
+    const int max_threads = max(1u, thread::hardware_concurrency());
+
+    vector<int> thread_counts;
+    for (int t = 1; t < max_threads; t *= 2) {
+        thread_counts.push_back(t);
+    }
+    thread_counts.push_back(max_threads);
+
+    cout << "threads" << setw(14) << "seconds" << setw(14) << "samples/s" << setw(10) << "speedup" << setw(14) << "reproducible" << endl;
+
+    double reference_seconds = 0.0;
+
+    for (int t : thread_counts) {
+
+        double e_in[2];
+        double seconds = 0.0;
+
+        for (int repetition = 0; repetition < 2; ++repetition) {
+
+            Strassen_NN snn(matrix_dimensions, rank_estimate, training_size, test_size, seed_num, 1,
+                            1e-2, 0.0, 1.0, 0, 1e-8, "");
+            snn.set_data_parallel(t, batch_size);
+            snn.run();
+
+            seconds = snn.get_training_time();
+            e_in[repetition] = snn.get_in_sample_error()[0];
+        }
+
+        if (t == 1) {
+            reference_seconds = seconds;
+        }
+
+        cout << setw(7) << t << setw(14) << seconds << setw(14) << training_size / seconds <<
+                setw(10) << reference_seconds / seconds << setw(14) << (e_in[0] == e_in[1] ? "yes" : "NO") << endl;
+    }
+}
+
+
 /**
  *  define command-line options
  *
@@ -52,6 +103,29 @@ void help()
     ("scale_factor,c",  value<vector<double>>()->multitoken(), "range scale factors for test data. Eg. 1 1e+2")
     ("learning_rate,l", value<vector<double>>()->multitoken(), "learning rates. Eg. 1e-2 1e-3")
     ("reg_param,r", value<vector<double>>()->multitoken(), "regularization parameters. Eg. 1e-2 1e-3")
+    ("pipelined", "overlap data generation, evaluation and saving of weights with training")
+    ("refine", value<int>(), "max. iterations of integer local search on the rounded weights after training")
+    ("threads,t", value<int>(), "number of worker threads (default: all cores)")
+    ("warm_start,w", value<vector<string>>()->multitoken(), "start from saved weights, given by directory and tag. Eg. 'DATA .../exp_id_0/' epoch120")
+    ("noise", value<double>(), "standard deviation of Gaussian noise added to the warm start")
+    ("flip", value<double>(), "probability to change a coefficient of the warm start to another value in {-1,0,1}")
+    ("symmetry_transform", "apply a random symmetry transformation to the warm start")
+    ("compose", value<vector<string>>()->multitoken(), "Kronecker product of two saved schemes, given by directory and tag each. Eg. dir1 epoch120 dir2 epoch80")
+    ("compose_train", "train with the composed scheme as warm start, instead of only saving it")
+    ("symmetry", value<string>(), "train symmetric weights for square matrices: none, cyclic (Z3) or transpose")
+    ("invariant_products", value<int>(), "number of products invariant under the symmetry (default: rank modulo orbit size)")
+    ("group_sparsity", value<double>(), "group lasso penalty on hidden units for rank annealing. Eg. 1e-3")
+    ("prune_threshold", value<double>(), "remove hidden units whose contribution falls below threshold. Eg. 1e-2")
+    ("min_rank", value<int>(), "rank below which no hidden units are removed")
+    ("dataset", value<string>(), "directory of shared training and test datasets, generated on first use")
+    ("dataset_size", value<int>(), "number of samples in a newly generated dataset (default: 10 x train, 10 x test)")
+    ("expected_loss", value<int>(), "train on the closed-form expected loss, with given number of gradient steps per epoch")
+    ("polish_window", value<int>(), "Levenberg-Marquardt polishing once the in-sample error plateaus over this many epochs")
+    ("polish_tolerance", value<double>(), "relative improvement of the in-sample error below which it has plateaued (default: 1e-3)")
+    ("polish_iterations", value<int>(), "max. Levenberg-Marquardt iterations per polishing (default: 50)")
+    ("batch_size,b", value<int>(), "synchronous data-parallel training with mini-batches of this size, on --threads threads")
+    ("scaling_report", "report training time per epoch of data-parallel training for 1 up to all cores, then exit")
+    ("serve", value<string>()->implicit_value("-"), "run as job server, reading JSON lines from stdin ('-', default) or a Unix domain socket path")
     ;
 }
 
@@ -75,6 +149,39 @@ int main(int argc, char* argv[])
 
     double threshold_eout = 1e-8; /// threshold E_out to save weight matrices
 
+    bool pipelined = false; /// sequential epochs by default
+
+    int refine_iterations = 0; /// no local search by default
+    int num_threads = 0;
+
+    /// warm start, random weights by default
+    vector<Warm_Start> warm_start;
+    double warm_start_noise = 0.0;
+    double warm_start_flip = 0.0;
+    bool warm_start_transform = false;
+
+    /// tied weights, independent weights by default
+    string symmetry = "none";
+    int num_invariant = -1;
+
+    /// rank annealing, fixed rank by default
+    double group_sparsity = 0.0;
+    double prune_threshold = 0.0;
+    int min_rank = 1;
+
+    int expected_loss_steps = 0; /// sampled training by default
+
+    int batch_size = 0; /// per-sample updates by default
+
+    /// second-order polishing, off by default
+    int polish_window = 0;
+    double polish_tolerance = 1e-3;
+    int polish_iterations = 50;
+
+    /// shared datasets, fresh samples every epoch by default
+    string dataset_path;
+    int dataset_size = 0;
+
     int seed_num = 0; /// control the seed for each experiment
 
     vector<double> regularization_parameters = {0};
@@ -82,6 +189,8 @@ int main(int argc, char* argv[])
     vector<double> learning_rates;
 
 
+    string serve_path; /// job server mode, if given
+
     /**
         general & combined option definitions
     */
@@ -205,6 +314,183 @@ int main(int argc, char* argv[])
             seed_num = vm["seed_init"].as<int>();
         }
 
+        if (vm.count("pipelined"))
+        {
+            pipelined = true;
+        }
+
+        if (vm.count("refine"))
+        {
+            refine_iterations = vm["refine"].as<int>();
+        }
+
+        if (vm.count("threads"))
+        {
+            num_threads = vm["threads"].as<int>();
+        }
+
+        if (vm.count("warm_start"))
+        {
+            const vector<string> source = vm["warm_start"].as<vector<string>>();
+            if ( source.size() != 2 ) {
+                cerr << "warm_start requires a directory and a tag" << endl;
+                exit(EXIT_FAILURE);
+            }
+
+            Warm_Start start = Warm_Start::load(source[0], source[1]);
+
+            /// smaller solutions, e.g. <2,2,2;7>, are used for larger shapes, e.g. <2,2,3>
+            auto fits = [&](int m, int n, int k) {
+                return (m <= matrix_dimensions[0]) && (n <= matrix_dimensions[1]) && (k <= matrix_dimensions[2]);
+            };
+            const vector<int> d = start.get_matrix_dimensions();
+            if ( !fits(d[0], d[1], d[2]) && fits(d[2], d[1], d[0]) ) {
+                start.transpose();
+            }
+            start.extend(matrix_dimensions);
+
+            if ( start.get_rank() > rank_estimate ) {
+                cerr << "warm start has rank " << start.get_rank() << " > " << rank_estimate << endl;
+                exit(EXIT_FAILURE);
+            }
+
+            warm_start.push_back(start);
+        }
+
+        if (vm.count("compose"))
+        {
+            const vector<string> sources = vm["compose"].as<vector<string>>();
+            if ( (sources.size() != 4) || vm.count("warm_start") ) {
+                cerr << "compose requires two directories and tags, and no warm_start" << endl;
+                exit(EXIT_FAILURE);
+            }
+
+            const auto start = chrono::steady_clock::now();
+
+            const Warm_Start composed = Warm_Start::kronecker(Warm_Start::load(sources[0], sources[1]),
+                                                              Warm_Start::load(sources[2], sources[3]));
+            const bool exact = composed.is_exact();
+
+            const chrono::duration<double, milli> elapsed = chrono::steady_clock::now() - start;
+
+            const vector<int>& d = composed.get_matrix_dimensions();
+            cout << "composed <" << d[0] << "," << d[1] << "," << d[2] << ";" << composed.get_rank() << ">, " <<
+                    (exact ? "exact" : "NOT exact") << ", " << elapsed.count() << " ms" << endl;
+
+            if ( vm.count("compose_train") ) {
+                /// e.g. reduce the rank from here with rank annealing
+                matrix_dimensions = d;
+                rank_estimate = max(rank_estimate, composed.get_rank());
+                warm_start.push_back(composed);
+            } else {
+                const string path = vm.count("path") ? vm["path"].as<string>() : "";
+                try {
+                    composed.save(path, "composed");
+                } catch(std::exception& e) {
+                    cerr << e.what() << endl;
+                    exit(EXIT_FAILURE);
+                }
+                exit(exact ? EXIT_SUCCESS : EXIT_FAILURE);
+            }
+        }
+
+        if (vm.count("noise"))
+        {
+            warm_start_noise = vm["noise"].as<double>();
+        }
+
+        if (vm.count("flip"))
+        {
+            warm_start_flip = vm["flip"].as<double>();
+        }
+
+        if (vm.count("symmetry_transform"))
+        {
+            warm_start_transform = true;
+        }
+
+        if (vm.count("symmetry"))
+        {
+            symmetry = vm["symmetry"].as<string>();
+        }
+
+        if (vm.count("invariant_products"))
+        {
+            num_invariant = vm["invariant_products"].as<int>();
+        }
+
+        /// SANITY CHECK, throws for unknown symmetries, non-square matrices or unsuitable ranks
+        if ( Weight_Tying::parse(symmetry) != Weight_Tying::none ) {
+            Weight_Tying(matrix_dimensions, rank_estimate, Weight_Tying::parse(symmetry), num_invariant);
+        }
+
+        if (vm.count("group_sparsity"))
+        {
+            group_sparsity = vm["group_sparsity"].as<double>();
+        }
+
+        if (vm.count("prune_threshold"))
+        {
+            prune_threshold = vm["prune_threshold"].as<double>();
+        }
+
+        if (vm.count("min_rank"))
+        {
+            min_rank = vm["min_rank"].as<int>();
+        }
+
+        if ( ( (group_sparsity > 0.0) || (prune_threshold > 0.0) ) && (symmetry != "none") ) {
+            cerr << "rank annealing is not available for symmetric weights" << endl;
+            exit(EXIT_FAILURE);
+        }
+
+        if (vm.count("dataset"))
+        {
+            dataset_path = vm["dataset"].as<string>();
+        }
+
+        if (vm.count("dataset_size"))
+        {
+            dataset_size = vm["dataset_size"].as<int>();
+        }
+
+        if (vm.count("expected_loss"))
+        {
+            expected_loss_steps = vm["expected_loss"].as<int>();
+        }
+
+        if (vm.count("polish_window"))
+        {
+            polish_window = vm["polish_window"].as<int>();
+        }
+
+        if (vm.count("polish_tolerance"))
+        {
+            polish_tolerance = vm["polish_tolerance"].as<double>();
+        }
+
+        if (vm.count("polish_iterations"))
+        {
+            polish_iterations = vm["polish_iterations"].as<int>();
+        }
+
+        if (vm.count("batch_size"))
+        {
+            batch_size = vm["batch_size"].as<int>();
+        }
+
+        if (vm.count("scaling_report"))
+        {
+            scaling_report(matrix_dimensions, rank_estimate, training_size, test_size,
+                           (batch_size > 0) ? batch_size : 256, seed_num);
+            exit(EXIT_SUCCESS);
+        }
+
+        if (vm.count("serve"))
+        {
+            serve_path = vm["serve"].as<string>();
+        }
+
         if (vm.count("path"))
         {
             data_series_path = vm["path"].as<string>();
@@ -240,9 +526,61 @@ int main(int argc, char* argv[])
     ///----------------------------------------------------------------------//
     ///----------------------------------------------------------------------//
 
+    /// jobs and their parameters are received from clients instead
+    if ( !serve_path.empty() ) {
+
+        try {
+            Job_Server server(num_threads);
+
+            if (serve_path == "-") {
+                server.serve_stream(cin, cout);
+            } else {
+                server.serve_socket(serve_path);
+            }
+        }
+        catch(std::exception& e)
+        {
+            cerr << e.what() << endl;
+            exit(EXIT_FAILURE);
+        }
+
+        return 0;
+    }
+
     ///for the entire series, create parent directory
     fs::create_directory(data_series_path);
 
+    /// the same samples for all experiments of the series (and all processes sharing the directory)
+    shared_ptr<const Shared_Dataset> training_data;
+    map<double, shared_ptr<const Shared_Dataset>> test_data;
+
+    if ( !dataset_path.empty() ) {
+        try {
+            fs::create_directory(dataset_path);
+
+            training_data = Shared_Dataset::open(dataset_path, matrix_dimensions,
+                                                 (dataset_size > 0) ? dataset_size : 10*training_size,
+                                                 Strassen_NN::training_range, 0);
+            for (auto rsf : range_scale_factors) {
+                test_data[rsf] = Shared_Dataset::open(dataset_path, matrix_dimensions,
+                                                      (dataset_size > 0) ? dataset_size : 10*test_size, rsf, 1);
+
+                if (test_data[rsf]->size() < static_cast<size_t>(test_size)) {
+                    throw runtime_error("test dataset has fewer samples than test size");
+                }
+            }
+
+            if (training_data->size() < static_cast<size_t>(training_size)) {
+                throw runtime_error("training dataset has fewer samples than training size");
+            }
+        }
+        catch(std::exception& e)
+        {
+            cerr << e.what() << endl;
+            exit(EXIT_FAILURE);
+        }
+    }
+
     for (auto rsf : range_scale_factors) {
         for (auto lr : learning_rates) {
             for (auto rp : regularization_parameters) {
@@ -268,8 +606,32 @@ int main(int argc, char* argv[])
                                     data_series_path,
                                     comment);
 
+                    snn.set_pipelined(pipelined);
+                    snn.set_datasets(training_data, test_data[rsf]);
+                    snn.set_expected_loss(expected_loss_steps);
+                    snn.set_polishing(polish_window, polish_tolerance, polish_iterations);
+                    snn.set_data_parallel(num_threads, batch_size);
+
+                    if ( !warm_start.empty() ) {
+                        Warm_Start start = warm_start.front();
+                        start.set_seed(seed_num);
+
+                        if (warm_start_transform) { start.random_transform(); }
+                        if (warm_start_flip > 0.0) { start.flip_coefficients(warm_start_flip); }
+                        if (warm_start_noise > 0.0) { start.add_noise(warm_start_noise); }
+
+                        snn.warm_start(start);
+                    }
+
+                    snn.set_symmetry(symmetry, num_invariant);
+                    snn.set_rank_annealing(group_sparsity, prune_threshold, min_rank);
+
                     /// train the network
                     snn.run();
+
+                    if (refine_iterations > 0) {
+                        snn.refine(refine_iterations, num_threads);
+                    }
                 }
             }
         }
@@ -0,0 +1,45 @@
+#include "Brent_Residual.h"
+
+using namespace std;
+using namespace arma;
+
+
+
+
+Brent_Residual::Brent_Residual(const vector<int>& matrix_dimensions,
+                               const mat& W_1A,
+                               const mat& W_1B,
+                               const mat& W_2)
+
+:   E(cube(W_2.n_rows, W_1A.n_cols, W_1B.n_cols, fill::zeros))
+
+{
+    const int m = matrix_dimensions[0];
+    const int n = matrix_dimensions[1];
+    const int k = matrix_dimensions[2];
+
+    for (uword b = 0; b < W_1B.n_cols; ++b) {
+        E.slice(b) = (W_2 * diagmat(W_1B.col(b))) * W_1A;
+    }
+
+    /// C(i,l) = sum_j A(i,j) B(j,l)
+    for (int i = 0; i < m; ++i) {
+        for (int j = 0; j < n; ++j) {
+            for (int l = 0; l < k; ++l) {
+                E(i + m*l, i + m*j, j + n*l) -= 1.0;
+            }
+        }
+    }
+}
+
+
+double Brent_Residual::squared_norm() const
+{
+    return accu(square(E));
+}
+
+
+bool Brent_Residual::is_exact(double tolerance) const
+{
+    return squared_norm() < tolerance;
+}
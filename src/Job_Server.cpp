@@ -0,0 +1,410 @@
+#include <chrono>
+#include <cstdio>
+#include <iomanip>
+#include <sstream>
+#include <stdexcept>
+#include <algorithm>
+#include <cerrno>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <boost/property_tree/ptree.hpp>
+#include <boost/property_tree/json_parser.hpp>
+#include "Job_Server.h"
+#include "Strassen_NN.h"
+#include "Brent_Residual.h"
+
+using namespace std;
+using namespace arma;
+namespace pt = boost::property_tree;
+
+
+
+
+/**
+    destination of result lines, shared by all jobs of one client
+*/
+class Result_Sink
+{
+    public:
+        virtual ~Result_Sink(){}
+        virtual void write(const string& line) = 0;
+
+    protected:
+        mutex write_mutex;
+};
+
+
+class Stream_Sink : public Result_Sink
+{
+    public:
+        Stream_Sink(ostream& out) : out(out) {}
+
+        void write(const string& line) override
+        {
+            lock_guard<mutex> lock(write_mutex);
+            out << line << endl;
+        }
+
+    private:
+        ostream& out;
+};
+
+
+/**
+    owns the connection, which is closed once the last job of the client is done
+*/
+class Socket_Sink : public Result_Sink
+{
+    public:
+        Socket_Sink(int fd) : fd(fd) {}
+        ~Socket_Sink() { close(fd); }
+
+        void write(const string& line) override
+        {
+            lock_guard<mutex> lock(write_mutex);
+
+            const string data = line + "\n";
+            size_t sent = 0;
+            while (sent < data.size()) {
+                const ssize_t n = send(fd, data.data() + sent, data.size() - sent, MSG_NOSIGNAL);
+                if (n <= 0) { return; } /// client went away
+                sent += n;
+            }
+        }
+
+    private:
+        int fd;
+};
+
+
+namespace
+{
+    string escape(const string& s)
+    {
+        string escaped;
+        for (char c : s) {
+            if (c == '"' || c == '\\') {
+                escaped += '\\';
+                escaped += c;
+            } else if (static_cast<unsigned char>(c) < 0x20) {
+                /// control characters are not allowed in JSON strings
+                char code[8];
+                snprintf(code, sizeof(code), "\\u%04x", static_cast<unsigned char>(c));
+                escaped += code;
+            } else {
+                escaped += c;
+            }
+        }
+        return escaped;
+    }
+
+    void write_matrix(ostream& out, const mat& W)
+    {
+        out << "[";
+        for (uword i = 0; i < W.n_rows; ++i) {
+            out << (i ? ",[" : "[");
+            for (uword j = 0; j < W.n_cols; ++j) {
+                out << (j ? "," : "") << W(i, j);
+            }
+            out << "]";
+        }
+        out << "]";
+    }
+}
+
+
+
+
+Job_Server::Job_Server(int num_threads)
+{
+    if (num_threads <= 0) {
+        num_threads = max(1u, thread::hardware_concurrency());
+    }
+
+    for (int t = 0; t < num_threads; ++t) {
+        workers.emplace_back(&Job_Server::work, this);
+    }
+}
+
+
+Job_Server::~Job_Server()
+{
+    /// readers submit jobs, so they go first
+    stop_readers();
+
+    {
+        lock_guard<mutex> lock(jobs_mutex);
+        stopping = true;
+    }
+    jobs_available.notify_all();
+
+    for (auto& w : workers) {
+        if (w.joinable()) { w.join(); }
+    }
+}
+
+
+void Job_Server::submit(const string& line, const shared_ptr<Result_Sink>& sink)
+{
+    {
+        lock_guard<mutex> lock(jobs_mutex);
+        jobs.push(Job{ line, sink });
+    }
+    jobs_available.notify_one();
+}
+
+
+/**
+    worker loop, returns once stopping and no jobs are left
+*/
+void Job_Server::work()
+{
+    Network_Cache networks;
+
+    while (true) {
+
+        Job job;
+        {
+            unique_lock<mutex> lock(jobs_mutex);
+            jobs_available.wait(lock, [this]() { return stopping || !jobs.empty(); });
+
+            if (jobs.empty()) {
+                return;
+            }
+
+            job = std::move(jobs.front());
+            jobs.pop();
+        }
+
+        job.sink->write( process(job.line, networks) );
+    }
+}
+
+
+string Job_Server::process(const string& line, Network_Cache& networks) const
+{
+    const auto start = chrono::steady_clock::now();
+
+    string id;
+    ostringstream result;
+    result << scientific << setprecision(17);
+
+    try {
+        pt::ptree job;
+        istringstream in(line);
+        pt::read_json(in, job);
+
+        id = job.get<string>("id", "");
+
+        vector<int> matrix_dimensions;
+        if (job.count("matrix_dimensions")) {
+            for (const auto& d : job.get_child("matrix_dimensions")) {
+                matrix_dimensions.push_back(d.second.get_value<int>());
+            }
+        } else {
+            matrix_dimensions = {2, 2, 2};
+        }
+
+        const int rank_estimate = job.get<int>("rank", 7);
+        const int epochs = job.get<int>("epochs", 5e+3);
+        const int training_size = job.get<int>("train", 1e+4);
+        const int test_size = job.get<int>("test", 1e+3);
+        const double learning_rate = job.get<double>("learning_rate", 1e-2);
+        const double regularization_parameter = job.get<double>("reg_param", 0.0);
+        const double range_scale_factor = job.get<double>("scale_factor", 1.0);
+        const int seed_num = job.get<int>("seed", 0);
+        const double threshold_eout = job.get<double>("threshold_eout", 1e-8);
+        const int refine_iterations = job.get<int>("refine", 0);
+
+        /// SANITY CHECK
+        if ( (matrix_dimensions.size() != 3) ||
+             (*min_element(matrix_dimensions.begin(), matrix_dimensions.end()) <= 0) ||
+             (rank_estimate <= 0) || (epochs <= 0) || (training_size <= 0) || (test_size <= 0) ) {
+            throw invalid_argument("invalid job parameters");
+        }
+
+        /// networks are allocated once per shape and rank
+        const string key = to_string(matrix_dimensions[0]) + "_" + to_string(matrix_dimensions[1]) + "_" +
+                           to_string(matrix_dimensions[2]) + "_" + to_string(rank_estimate);
+
+        auto& snn = networks[key];
+        if ( !snn ) {
+            snn.reset(new Strassen_NN(matrix_dimensions, rank_estimate, training_size, test_size, seed_num, epochs,
+                                      learning_rate, regularization_parameter, range_scale_factor, 0, threshold_eout, ""));
+        }
+
+        snn->reconfigure(training_size, test_size, seed_num, epochs,
+                         learning_rate, regularization_parameter, range_scale_factor, threshold_eout);
+        snn->run();
+
+        if (refine_iterations > 0) {
+            /// the server's workers already occupy the cores, one refiner thread per job
+            snn->refine(refine_iterations, 1);
+        }
+
+        const vec& e_out = snn->get_out_sample_error();
+        const uword best_epoch = e_out.index_min();
+        const bool exact = Brent_Residual(matrix_dimensions, snn->get_W_1A(), snn->get_W_1B(), snn->get_W_2()).is_exact();
+
+        result << "{\"id\":\"" << escape(id) << "\",\"status\":\"ok\"" <<
+                  ",\"exact\":" << (exact ? "true" : "false") <<
+                  ",\"best_epoch\":" << best_epoch <<
+                  ",\"best_out_sample_error\":" << e_out[best_epoch] <<
+                  ",\"final_in_sample_error\":" << snn->get_in_sample_error()[epochs-1] <<
+                  ",\"final_out_sample_error\":" << e_out[epochs-1];
+
+        result << defaultfloat << ",\"W_1A\":";
+        write_matrix(result, snn->get_W_1A());
+        result << ",\"W_1B\":";
+        write_matrix(result, snn->get_W_1B());
+        result << ",\"W_2\":";
+        write_matrix(result, snn->get_W_2());
+
+    } catch (const exception& e) {
+        result.str("");
+        result << "{\"id\":\"" << escape(id) << "\",\"status\":\"error\",\"message\":\"" << escape(e.what()) << "\"";
+    }
+
+    const chrono::duration<double> seconds = chrono::steady_clock::now() - start;
+    result << ",\"seconds\":" << seconds.count() << "}";
+
+    return result.str();
+}
+
+
+void Job_Server::serve_stream(istream& in, ostream& out)
+{
+    auto sink = make_shared<Stream_Sink>(out);
+
+    string line;
+    while (getline(in, line)) {
+        if (line.find_first_not_of(" \t\r") == string::npos) { continue; }
+        submit(line, sink);
+    }
+
+    /// finish all jobs
+    {
+        lock_guard<mutex> lock(jobs_mutex);
+        stopping = true;
+    }
+    jobs_available.notify_all();
+
+    for (auto& w : workers) {
+        w.join();
+    }
+}
+
+
+void Job_Server::serve_socket(const string& socket_path)
+{
+    const int server_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+
+    sockaddr_un address = {};
+    address.sun_family = AF_UNIX;
+    if ( (server_fd < 0) || (socket_path.size() >= sizeof(address.sun_path)) ) {
+        throw runtime_error("cannot create socket " + socket_path);
+    }
+    socket_path.copy(address.sun_path, socket_path.size());
+
+    /// replace a stale socket, but never another file
+    struct stat status;
+    if (lstat(socket_path.c_str(), &status) == 0) {
+        if ( !S_ISSOCK(status.st_mode) ) {
+            close(server_fd);
+            throw runtime_error(socket_path + ": path exists and is not a socket");
+        }
+        unlink(socket_path.c_str());
+    }
+
+    if ( (::bind(server_fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) < 0) || (listen(server_fd, 64) < 0) ) {
+        close(server_fd);
+        throw runtime_error("cannot listen on socket " + socket_path);
+    }
+
+    for (size_t id = 0; ; ++id) {
+        const int fd = accept(server_fd, nullptr, nullptr);
+        if (fd < 0) {
+            if (errno == EINTR) { continue; }
+            break;
+        }
+
+        lock_guard<mutex> lock(readers_mutex);
+
+        /// reap readers of closed connections
+        for (size_t finished : finished_readers) {
+            readers[finished].join();
+            readers.erase(finished);
+        }
+        finished_readers.clear();
+
+        open_connections.insert(fd);
+        readers[id] = thread(&Job_Server::read_connection, this, id, fd);
+    }
+
+    stop_readers();
+
+    close(server_fd);
+    unlink(socket_path.c_str());
+}
+
+
+/**
+    stop receiving on all connections and wait for their readers,
+    jobs already submitted are still processed and answered
+*/
+void Job_Server::stop_readers()
+{
+    map<size_t, thread> stopped;
+    {
+        lock_guard<mutex> lock(readers_mutex);
+
+        /// a registered connection is still open, its reader holds the sink
+        for (int fd : open_connections) {
+            shutdown(fd, SHUT_RD);
+        }
+        stopped.swap(readers);
+        finished_readers.clear();
+    }
+
+    for (auto& reader : stopped) {
+        reader.second.join();
+    }
+}
+
+
+/**
+    submit every line received from a client, results go back over the same connection
+*/
+void Job_Server::read_connection(size_t id, int fd)
+{
+    shared_ptr<Result_Sink> sink = make_shared<Socket_Sink>(fd);
+
+    string pending;
+    char buffer[4096];
+
+    ssize_t n;
+    while ( (n = recv(fd, buffer, sizeof(buffer), 0)) > 0 ) {
+        pending.append(buffer, n);
+
+        size_t end;
+        while ( (end = pending.find('\n')) != string::npos ) {
+            const string line = pending.substr(0, end);
+            pending.erase(0, end + 1);
+
+            if (line.find_first_not_of(" \t\r") != string::npos) {
+                submit(line, sink);
+            }
+        }
+    }
+
+    if (pending.find_first_not_of(" \t\r") != string::npos) {
+        submit(pending, sink);
+    }
+
+    /// deregister before the sink may close the connection
+    lock_guard<mutex> lock(readers_mutex);
+    open_connections.erase(fd);
+    finished_readers.push_back(id);
+}
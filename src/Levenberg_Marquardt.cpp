@@ -0,0 +1,148 @@
+#include "Levenberg_Marquardt.h"
+#include "Brent_Residual.h"
+
+using namespace std;
+using namespace arma;
+
+
+
+
+Levenberg_Marquardt::Levenberg_Marquardt(const vector<int>& matrix_dimensions,
+                                         double lambda,
+                                         size_t cg_iterations)
+
+:   matrix_dimensions(matrix_dimensions),
+    initial_lambda(lambda),
+    cg_iterations(cg_iterations)
+
+{
+}
+
+
+/**
+    rows: residuals E(c,a,b) in the memory order of the residual cube,
+    columns: vec(W_1A), vec(W_1B), vec(W_2)
+*/
+sp_mat Levenberg_Marquardt::jacobian(const mat& W_1A, const mat& W_1B, const mat& W_2) const
+{
+    const uword rank = W_1A.n_rows;
+    const uword n_a = W_1A.n_cols;
+    const uword n_b = W_1B.n_cols;
+    const uword n_c = W_2.n_rows;
+
+    const uword offset_1B = W_1A.n_elem;
+    const uword offset_2 = W_1A.n_elem + W_1B.n_elem;
+
+    const uword nonzeros = n_c*n_a*n_b * 3*rank;
+    umat locations(2, nonzeros);
+    vec values(nonzeros);
+
+    uword q = 0;
+    for (uword b = 0; b < n_b; ++b) {
+        for (uword a = 0; a < n_a; ++a) {
+            for (uword c = 0; c < n_c; ++c) {
+
+                const uword row = c + n_c*(a + n_a*b);
+
+                for (uword r = 0; r < rank; ++r) {
+                    /// dE/dW_1A(r,a)
+                    locations(0, q) = row; locations(1, q) = r + rank*a;
+                    values[q++] = W_2(c, r) * W_1B(r, b);
+                    /// dE/dW_1B(r,b)
+                    locations(0, q) = row; locations(1, q) = offset_1B + r + rank*b;
+                    values[q++] = W_2(c, r) * W_1A(r, a);
+                    /// dE/dW_2(c,r)
+                    locations(0, q) = row; locations(1, q) = offset_2 + c + n_c*r;
+                    values[q++] = W_1A(r, a) * W_1B(r, b);
+                }
+            }
+        }
+    }
+
+    return sp_mat(locations, values, n_c*n_a*n_b, offset_2 + W_2.n_elem);
+}
+
+
+vec Levenberg_Marquardt::conjugate_gradient(const sp_mat& J, const sp_mat& J_t, const vec& d, double lambda, const vec& rhs) const
+{
+    /// Jacobi preconditioner, diag(J^T J) + lambda d
+    vec preconditioner(J.n_cols, fill::zeros);
+    for (sp_mat::const_iterator it = J.begin(); it != J.end(); ++it) {
+        preconditioner[it.col()] += (*it) * (*it);
+    }
+    preconditioner += lambda * d;
+
+    vec x(J.n_cols, fill::zeros);
+    vec r = rhs;
+    vec z = r / preconditioner;
+    vec p = z;
+    double rz = dot(r, z);
+
+    const double stop = 1e-10 * norm(rhs);
+
+    for (size_t i = 0; (i < cg_iterations) && (norm(r) > stop); ++i) {
+
+        const vec Ap = J_t * vec(J * p) + lambda * (d % p);
+        const double alpha = rz / dot(p, Ap);
+
+        x += alpha * p;
+        r -= alpha * Ap;
+
+        z = r / preconditioner;
+        const double rz_next = dot(r, z);
+        p = z + (rz_next / rz) * p;
+        rz = rz_next;
+    }
+
+    return x;
+}
+
+
+double Levenberg_Marquardt::polish(mat& W_1A, mat& W_1B, mat& W_2, size_t max_iterations, double tolerance)
+{
+    double lambda = initial_lambda;
+
+    vec e = vectorise(Brent_Residual(matrix_dimensions, W_1A, W_1B, W_2).get_residual());
+    double cost = dot(e, e);
+
+    for (size_t i = 0; (i < max_iterations) && (cost > tolerance) && (lambda < 1e+10); ++i) {
+
+        const sp_mat J = jacobian(W_1A, W_1B, W_2);
+        const sp_mat J_t = J.t();
+
+        /// Marquardt scaling, shifted so that unused parameters stay regular
+        vec d(J.n_cols, fill::ones);
+        for (sp_mat::const_iterator it = J.begin(); it != J.end(); ++it) {
+            d[it.col()] += (*it) * (*it);
+        }
+
+        const vec gradient = J_t * e;
+
+        /// increase damping until the step reduces the residual
+        while (lambda < 1e+10) {
+
+            const vec step = conjugate_gradient(J, J_t, d, lambda, -gradient);
+
+            mat W_1A_trial = W_1A + reshape(step.head(W_1A.n_elem), W_1A.n_rows, W_1A.n_cols);
+            mat W_1B_trial = W_1B + reshape(step.subvec(W_1A.n_elem, W_1A.n_elem + W_1B.n_elem - 1), W_1B.n_rows, W_1B.n_cols);
+            mat W_2_trial = W_2 + reshape(step.tail(W_2.n_elem), W_2.n_rows, W_2.n_cols);
+
+            const vec e_trial = vectorise(Brent_Residual(matrix_dimensions, W_1A_trial, W_1B_trial, W_2_trial).get_residual());
+            const double cost_trial = dot(e_trial, e_trial);
+
+            if (cost_trial < cost) {
+                W_1A = W_1A_trial;
+                W_1B = W_1B_trial;
+                W_2 = W_2_trial;
+                e = e_trial;
+                cost = cost_trial;
+                lambda *= 0.3;
+                break;
+            }
+
+            lambda *= 10.0;
+        }
+    }
+
+    return cost;
+}
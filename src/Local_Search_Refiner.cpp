@@ -0,0 +1,263 @@
+#include <thread>
+#include <limits>
+#include <memory>
+#include <algorithm>
+#include <functional>
+#include "Local_Search_Refiner.h"
+#include "Brent_Residual.h"
+#include "Worker_Pool.h"
+
+using namespace std;
+using namespace arma;
+
+
+
+
+Local_Search_Refiner::Local_Search_Refiner(const vector<int>& matrix_dimensions,
+                                           const mat& W_1A,
+                                           const mat& W_1B,
+                                           const mat& W_2,
+                                           int num_threads,
+                                           size_t tabu_tenure)
+
+:   num_threads(num_threads > 0 ? num_threads : max(1u, thread::hardware_concurrency())),
+    tabu_tenure(tabu_tenure),
+    W_1A(arma::round(W_1A)),
+    W_1B(arma::round(W_1B)),
+    W_2(arma::round(W_2)),
+    E(Brent_Residual(matrix_dimensions, this->W_1A, this->W_1B, this->W_2).get_residual()),
+    loss(accu(square(E))),
+    tabu_until(this->W_1A.n_elem + this->W_1B.n_elem + this->W_2.n_elem, 0),
+    best_W_1A(this->W_1A),
+    best_W_1B(this->W_1B),
+    best_W_2(this->W_2),
+    best_loss(loss)
+
+{
+    /// default tenure grows slowly with the number of coefficients
+    if (this->tabu_tenure == 0) {
+        this->tabu_tenure = 5 + tabu_until.size() / 20;
+    }
+}
+
+
+int Local_Search_Refiner::decode(size_t coefficient, uword& row, uword& col) const
+{
+    int which = 0;
+
+    if (coefficient >= W_1A.n_elem) {
+        coefficient -= W_1A.n_elem;
+        ++which;
+
+        if (coefficient >= W_1B.n_elem) {
+            coefficient -= W_1B.n_elem;
+            ++which;
+        }
+    }
+
+    const uword n_rows = (which == 0) ? W_1A.n_rows : ((which == 1) ? W_1B.n_rows : W_2.n_rows);
+    row = coefficient % n_rows;
+    col = coefficient / n_rows;
+
+    return which;
+}
+
+
+double Local_Search_Refiner::value_of(size_t coefficient) const
+{
+    uword row, col;
+    const int which = decode(coefficient, row, col);
+
+    return (which == 0) ? W_1A(row, col) : ((which == 1) ? W_1B(row, col) : W_2(row, col));
+}
+
+
+/**
+    change of the squared residual if the coefficient is set to value,
+
+        sum (E + u)^2 - E^2 = sum u (2E + u)
+
+    over the entries u != 0 affected by the coefficient
+*/
+double Local_Search_Refiner::evaluate_move(size_t coefficient, double value) const
+{
+    uword row, col;
+    const int which = decode(coefficient, row, col);
+
+    double delta = 0.0;
+
+    if (which == 0) {
+        /// W_1A(r,a)
+        const uword r = row, a = col;
+        const double d = value - W_1A(r, a);
+
+        for (uword b = 0; b < E.n_slices; ++b) {
+            if (W_1B(r, b) == 0.0) { continue; }
+            for (uword c = 0; c < E.n_rows; ++c) {
+                const double u = d * W_2(c, r) * W_1B(r, b);
+                delta += u * (2*E(c, a, b) + u);
+            }
+        }
+    } else if (which == 1) {
+        /// W_1B(r,b)
+        const uword r = row, b = col;
+        const double d = value - W_1B(r, b);
+
+        for (uword a = 0; a < E.n_cols; ++a) {
+            if (W_1A(r, a) == 0.0) { continue; }
+            for (uword c = 0; c < E.n_rows; ++c) {
+                const double u = d * W_2(c, r) * W_1A(r, a);
+                delta += u * (2*E(c, a, b) + u);
+            }
+        }
+    } else {
+        /// W_2(c,r)
+        const uword c = row, r = col;
+        const double d = value - W_2(c, r);
+
+        for (uword b = 0; b < E.n_slices; ++b) {
+            if (W_1B(r, b) == 0.0) { continue; }
+            for (uword a = 0; a < E.n_cols; ++a) {
+                const double u = d * W_1A(r, a) * W_1B(r, b);
+                delta += u * (2*E(c, a, b) + u);
+            }
+        }
+    }
+
+    return delta;
+}
+
+
+void Local_Search_Refiner::apply_move(size_t coefficient, double value)
+{
+    uword row, col;
+    const int which = decode(coefficient, row, col);
+
+    if (which == 0) {
+        const uword r = row, a = col;
+        const double d = value - W_1A(r, a);
+
+        for (uword b = 0; b < E.n_slices; ++b) {
+            for (uword c = 0; c < E.n_rows; ++c) {
+                E(c, a, b) += d * W_2(c, r) * W_1B(r, b);
+            }
+        }
+        W_1A(r, a) = value;
+    } else if (which == 1) {
+        const uword r = row, b = col;
+        const double d = value - W_1B(r, b);
+
+        for (uword a = 0; a < E.n_cols; ++a) {
+            for (uword c = 0; c < E.n_rows; ++c) {
+                E(c, a, b) += d * W_2(c, r) * W_1A(r, a);
+            }
+        }
+        W_1B(r, b) = value;
+    } else {
+        const uword c = row, r = col;
+        const double d = value - W_2(c, r);
+
+        for (uword b = 0; b < E.n_slices; ++b) {
+            for (uword a = 0; a < E.n_cols; ++a) {
+                E(c, a, b) += d * W_1A(r, a) * W_1B(r, b);
+            }
+        }
+        W_2(c, r) = value;
+    }
+}
+
+
+/**
+    best admissible move among coefficients [first, last).
+    Tabu moves are admissible only if they improve on the best point (aspiration).
+*/
+Local_Search_Refiner::Move Local_Search_Refiner::best_move(size_t first, size_t last, size_t iteration) const
+{
+    Move best { 0, 0.0, std::numeric_limits<double>::max() };
+
+    for (size_t q = first; q < last; ++q) {
+
+        const double current = value_of(q);
+
+        for (double value = -1.0; value <= 1.0; value += 1.0) {
+
+            if (value == current) { continue; }
+
+            const double delta = evaluate_move(q, value);
+
+            const bool is_tabu = tabu_until[q] > iteration;
+            const bool aspiration = loss + delta < best_loss - 0.5;
+
+            /// strict comparison keeps the lowest index on ties
+            if ( (!is_tabu || aspiration) && (delta < best.delta) ) {
+                best = Move{ q, value, delta };
+            }
+        }
+    }
+
+    return best;
+}
+
+
+/**
+    returns true if an exact scheme has been found.
+    All coefficients and targets are integers, hence so is the loss.
+*/
+bool Local_Search_Refiner::run(size_t max_iterations)
+{
+    const size_t num_coefficients = tabu_until.size();
+
+    /// scoring a block of coefficients must outweigh the cost of waking a thread,
+    /// small schemes are searched serially
+    const size_t grain = 256;
+    const int workers = static_cast<int>( max<size_t>(1, min<size_t>(num_threads, num_coefficients / grain)) );
+    const size_t chunk = (num_coefficients + workers - 1) / workers;
+
+    unique_ptr<Worker_Pool> pool;
+    if (workers > 1) {
+        pool.reset(new Worker_Pool(workers));
+    }
+
+    vector<Move> moves(workers);
+    size_t iteration = 0;
+
+    /// one contiguous block of coefficients per thread
+    const function<void(int)> search = [this, &moves, &iteration, chunk, num_coefficients](int t) {
+        const size_t first = min(num_coefficients, t*chunk);
+        const size_t last = min(num_coefficients, first + chunk);
+
+        moves[t] = best_move(first, last, iteration);
+    };
+
+    for (; (iteration < max_iterations) && (best_loss > 0.5); ++iteration) {
+
+        if (pool) {
+            pool->run(search);
+        } else {
+            search(0);
+        }
+
+        /// reduce in thread order, so the result does not depend on scheduling
+        Move move = moves[0];
+        for (int t = 1; t < workers; ++t) {
+            if (moves[t].delta < move.delta) { move = moves[t]; }
+        }
+
+        if (move.delta == std::numeric_limits<double>::max()) {
+            break; /// every move is tabu
+        }
+
+        apply_move(move.coefficient, move.value);
+        loss += move.delta;
+        tabu_until[move.coefficient] = iteration + 1 + tabu_tenure;
+
+        if (loss < best_loss - 0.5) {
+            best_loss = loss;
+            best_W_1A = W_1A;
+            best_W_1B = W_1B;
+            best_W_2 = W_2;
+        }
+    }
+
+    return best_loss < 0.5;
+}
@@ -0,0 +1,148 @@
+#include <cstdio>
+#include <cstring>
+#include <random>
+#include <sstream>
+#include <fstream>
+#include <stdexcept>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "Shared_Dataset.h"
+
+using namespace std;
+using namespace arma;
+
+
+namespace
+{
+    const char dataset_magic[8] = {'S','N','N','D','A','T','A','1'};
+}
+
+
+
+
+Shared_Dataset::Shared_Dataset(const string& file_name)
+
+:   mapping(MAP_FAILED),
+    mapping_size(0)
+
+{
+    static_assert(sizeof(Header) == 64, "dataset header must be 64 bytes");
+
+    const int fd = ::open(file_name.c_str(), O_RDONLY);
+    struct stat file_status;
+
+    if ( (fd < 0) || (fstat(fd, &file_status) < 0) ) {
+        if (fd >= 0) { close(fd); }
+        throw runtime_error("cannot open dataset " + file_name);
+    }
+
+    mapping_size = file_status.st_size;
+    if (mapping_size >= sizeof(Header)) {
+        mapping = mmap(nullptr, mapping_size, PROT_READ, MAP_SHARED, fd, 0);
+    }
+    close(fd); /// the mapping stays valid
+
+    if (mapping == MAP_FAILED) {
+        throw runtime_error("cannot map dataset " + file_name);
+    }
+
+    const Header* header = static_cast<const Header*>(mapping);
+
+    matrix_dimensions = { header->m, header->n, header->k };
+    num_samples = header->num_samples;
+    scale = header->scale;
+    sample_size = header->m*header->n + header->n*header->k + header->m*header->k;
+    samples = reinterpret_cast<const double*>(static_cast<const char*>(mapping) + sizeof(Header));
+
+    if ( (memcmp(header->magic, dataset_magic, sizeof(dataset_magic)) != 0) ||
+         (mapping_size != sizeof(Header) + num_samples*sample_size*sizeof(double)) ) {
+        munmap(mapping, mapping_size);
+        throw runtime_error("corrupt dataset " + file_name);
+    }
+}
+
+
+Shared_Dataset::~Shared_Dataset()
+{
+    munmap(mapping, mapping_size);
+}
+
+
+string Shared_Dataset::file_name(const string& directory, const vector<int>& matrix_dimensions, size_t size, double scale, unsigned long long seed)
+{
+    stringstream name;
+    name << directory << (directory.empty() || directory.back() == '/' ? "" : "/") <<
+            "dataset_" << matrix_dimensions[0] << "_" << matrix_dimensions[1] << "_" << matrix_dimensions[2] <<
+            "_size_" << size << "_scale_" << scale << "_seed_" << seed << ".bin";
+
+    return name.str();
+}
+
+
+/**
+    written to a temporary file first and renamed, so concurrent
+    workers never map a partially written dataset
+*/
+void Shared_Dataset::generate(const string& file_name,
+                              const vector<int>& matrix_dimensions,
+                              size_t size,
+                              double scale,
+                              unsigned long long seed)
+{
+    const int m = matrix_dimensions[0];
+    const int n = matrix_dimensions[1];
+    const int k = matrix_dimensions[2];
+
+    Header header = {};
+    memcpy(header.magic, dataset_magic, sizeof(dataset_magic));
+    header.m = m;
+    header.n = n;
+    header.k = k;
+    header.num_samples = size;
+    header.scale = scale;
+
+    const string temporary_name = file_name + ".tmp" + to_string(getpid());
+    ofstream file(temporary_name, ios::binary);
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+
+    mt19937_64 engine(seed);
+    uniform_real_distribution<double> distribution(-scale, scale);
+
+    mat A(m, n);
+    mat B(n, k);
+    mat C(m, k);
+
+    for (size_t i = 0; i < size; ++i) {
+        for (auto& a : A) { a = distribution(engine); }
+        for (auto& b : B) { b = distribution(engine); }
+        C = A * B;
+
+        file.write(reinterpret_cast<const char*>(A.memptr()), A.n_elem*sizeof(double));
+        file.write(reinterpret_cast<const char*>(B.memptr()), B.n_elem*sizeof(double));
+        file.write(reinterpret_cast<const char*>(C.memptr()), C.n_elem*sizeof(double));
+    }
+
+    file.close();
+    if ( !file || (rename(temporary_name.c_str(), file_name.c_str()) != 0) ) {
+        remove(temporary_name.c_str());
+        throw runtime_error("cannot write dataset " + file_name);
+    }
+}
+
+
+shared_ptr<const Shared_Dataset> Shared_Dataset::open(const string& directory,
+                                                      const vector<int>& matrix_dimensions,
+                                                      size_t size,
+                                                      double scale,
+                                                      unsigned long long seed)
+{
+    const string name = file_name(directory, matrix_dimensions, size, scale, seed);
+
+    if (access(name.c_str(), R_OK) != 0) {
+        generate(name, matrix_dimensions, size, scale, seed);
+    }
+
+    return make_shared<const Shared_Dataset>(name);
+}
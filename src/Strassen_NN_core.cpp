@@ -1,11 +1,21 @@
 #include <string>
+#include <cmath>
 #include <limits>
+#include <algorithm>
 #include <iomanip>
 #include <ctime>
 #include <chrono>
 #include <cstdlib>
+#include <future>
+#include <random>
+#include <stdexcept>
 #include <experimental/filesystem>
 #include "Strassen_NN.h"
+#include "Local_Search_Refiner.h"
+#include "Warm_Start.h"
+#include "Weight_Tying.h"
+#include "Shared_Dataset.h"
+#include "Levenberg_Marquardt.h"
 
 using namespace std;
 using namespace arma;
@@ -81,7 +91,8 @@ Strassen_NN::Strassen_NN(vector<int>& matrix_dimensions,
 
     /// errors
     in_sample_error(std::numeric_limits<double>::max() * vec(epochs, fill::ones)),
-    out_sample_error(std::numeric_limits<double>::max() * vec(epochs, fill::ones))
+    out_sample_error(std::numeric_limits<double>::max() * vec(epochs, fill::ones)),
+    rank_history(rank_estimate * vec(epochs, fill::ones))
 
 {
     //
@@ -96,6 +107,11 @@ Strassen_NN::Strassen_NN(vector<int>& matrix_dimensions,
     W_2 *= 2; W_2 -= 1;
 
 
+    /// without a data series path, nothing is written to disk (e.g. in job server mode)
+    if ( data_series_path.empty() ) {
+        return;
+    }
+
     /// create a directory to save the data for this SNN instance
     std::stringstream path;
     path << data_series_path <<
@@ -113,15 +129,140 @@ Strassen_NN::Strassen_NN(vector<int>& matrix_dimensions,
 }
 
 
+/**
+    Reuse the allocated network for a new experiment of the same shape and rank.
+    Weights are drawn anew from the given seed.
+*/
+void Strassen_NN::reconfigure(size_t training_size,
+                              size_t test_size,
+                              int seed_num,
+                              size_t epochs,
+                              double learning_rate,
+                              double regularization_parameter,
+                              double range_scale_factor,
+                              double threshold_error_out)
+{
+    this->training_size = training_size;
+    this->test_size = test_size;
+    this->seed_num = seed_num;
+    this->learning_rate = learning_rate;
+    this->regularization_parameter = regularization_parameter;
+    this->weight_decay_factor = learning_rate*regularization_parameter/training_size;
+    this->range_scale_factor = range_scale_factor;
+    this->threshold_error_out = threshold_error_out;
+
+    /// own stream, so the weights do not replay the training data drawn from seed_num in run()
+    const unsigned long long weight_stream = std::numeric_limits<unsigned long long>::max();
+    std::seed_seq seed{ static_cast<unsigned long long>(seed_num), weight_stream };
+    std::mt19937_64 engine(seed);
+    std::uniform_real_distribution<double> distribution(-1.0, 1.0);
+
+    for (auto& w : W_1A) { w = distribution(engine); }
+    for (auto& w : W_1B) { w = distribution(engine); }
+    for (auto& w : W_2) { w = distribution(engine); }
+
+    reset_optimizer_state();
+
+    tie_weights();
+
+    set_epochs(epochs);
+}
+
+
 void Strassen_NN::set_epochs(int e)
 {
     epochs = e;
-    in_sample_error.set_size( epochs );
-    out_sample_error.set_size( epochs );
+    in_sample_error = std::numeric_limits<double>::max() * vec(epochs, fill::ones);
+    out_sample_error = std::numeric_limits<double>::max() * vec(epochs, fill::ones);
+    rank_history = rank_estimate * vec(epochs, fill::ones);
+    last_polish = 0;
+}
+
+
+/**
+    zero momentum and RMS estimates and restart the Adam bias correction,
+    e.g. after the weights have been replaced
+*/
+void Strassen_NN::reset_optimizer_state()
+{
+    v_dW_1A.zeros(); S_dW_1A.zeros();
+    v_dW_1B.zeros(); S_dW_1B.zeros();
+    v_dW_2.zeros(); S_dW_2.zeros();
+
+    beta_1_t = 1.0;
+    beta_2_t = 1.0;
+}
+
+
+/**
+    Start from a given weight set instead of random weights.
+    If the network has more hidden units than the warm start,
+    the remaining units keep small random weights, so they can still learn.
+*/
+void Strassen_NN::warm_start(const Warm_Start& start, int e)
+{
+    const int rank = start.get_rank();
+
+    if ( start.get_matrix_dimensions() != matrix_dimensions ) {
+        throw invalid_argument("warm start has different matrix dimensions");
+    }
+    if ( rank > rank_estimate ) {
+        throw invalid_argument("warm start has rank " + to_string(rank) + " > " + to_string(rank_estimate));
+    }
+
+    W_1A *= 1e-2;
+    W_1B *= 1e-2;
+    W_2 *= 1e-2;
+
+    W_1A.rows(0, rank-1) = start.get_W_1A();
+    W_1B.rows(0, rank-1) = start.get_W_1B();
+    W_2.cols(0, rank-1) = start.get_W_2();
+
+    reset_optimizer_state();
+
+    tie_weights();
+
+    if (e > 0) {
+        set_epochs(e);
+    }
+}
+
+
+void Strassen_NN::set_pipelined(bool p)
+{
+    pipelined = p;
+}
+
+
+/**
+    train on the exact expected loss instead of samples,
+    with the given number of gradient steps per epoch (0: sampled training)
+*/
+void Strassen_NN::set_expected_loss(size_t steps_per_epoch)
+{
+    expected_loss_steps = steps_per_epoch;
+}
+
+
+/**
+    Levenberg-Marquardt polishing once the in-sample error stops improving
+    by the relative tolerance within window epochs (window 0: never)
+*/
+void Strassen_NN::set_polishing(size_t window, double tolerance, size_t iterations)
+{
+    polish_window = window;
+    polish_tolerance = tolerance;
+    polish_iterations = iterations;
 }
 
 
 double Strassen_NN::forward_propagation(const mat& A, const mat& B)
+{
+    return forward_propagation(A, B, A * B);
+}
+
+
+double Strassen_NN::forward_propagation(const mat& A, const mat& B, const mat& C)
 {
     /// vectorized input for network
     x_0A = vectorise(A);
@@ -137,7 +278,7 @@ double Strassen_NN::forward_propagation(const mat& A, const mat& B)
     x_2 = W_2 * x_1;
 
     /// compute target for this data & current deviation
-    delta_2 = x_2 - vectorise( A * B );
+    delta_2 = x_2 - vectorise( C );
 
     return dot(delta_2, delta_2);
 }
@@ -169,18 +310,40 @@ void Strassen_NN::backward_propagation()
 
 void Strassen_NN::momentum(const vec& delta, const vec& x, mat& W, mat& v_dW)
 {
-    const mat dW = delta * x.t();
+    momentum(delta * x.t(), W, v_dW);
+}
+
+void Strassen_NN::momentum(const mat& dW, mat& W, mat& v_dW)
+{
     v_dW = beta_1 * v_dW + learning_rate * dW;
     W -= v_dW + weight_decay_factor *  W;
 }
 
 void Strassen_NN::update_weight_matrices()
 {
-    momentum(delta_2, x_1, W_2, v_dW_2);
-    momentum(delta_1A, x_0A, W_1A, v_dW_1A);
-    momentum(delta_1B, x_0B, W_1B, v_dW_1B);
+    if (tying) {
+        update_tied_weights(tying->gradient(delta_1A, x_0A, delta_1B, x_0B, delta_2, x_1));
+        return;
+    }
+
+    update_weight_matrices(delta_1A * x_0A.t(), delta_1B * x_0B.t(), delta_2 * x_1.t());
 }
 
+void Strassen_NN::update_weight_matrices(const mat& dW_1A, const mat& dW_1B, const mat& dW_2)
+{
+    if (tying) {
+        update_tied_weights(tying->gradient(dW_1A, dW_1B, dW_2));
+        return;
+    }
+
+    momentum(dW_2, W_2, v_dW_2);
+    momentum(dW_1A, W_1A, v_dW_1A);
+    momentum(dW_1B, W_1B, v_dW_1B);
+
+    if (group_sparsity > 0.0) {
+        shrink_hidden_units();
+    }
+}
 
 
 /**
@@ -193,8 +356,11 @@ void Strassen_NN::update_weight_matrices()
 
 void Strassen_NN::adam_optimization(const vec& delta, const vec& x, mat& W, mat& v_dW, mat& S_dW)
 {
-    mat dW = delta * x.t();
+    adam_optimization(delta * x.t(), W, v_dW, S_dW);
+}
 
+void Strassen_NN::adam_optimization(const mat& dW, mat& W, mat& v_dW, mat& S_dW)
+{
     v_dW = beta_1 * v_dW + (1-beta_1) * dW;
     S_dW = beta_2 * S_dW + (1-beta_2) * arma::square(dW);
 
@@ -224,6 +390,16 @@ void Strassen_NN::adam_optimization(const vec& delta, const vec& x, mat& W, mat&
 
 */
 void Strassen_NN::run()
+{
+    if (pipelined) {
+        run_pipelined();
+    } else {
+        run_sequential();
+    }
+}
+
+
+void Strassen_NN::run_sequential()
 {
     /// control seed for experiment
     arma_rng::set_seed(seed_num);
@@ -232,31 +408,40 @@ void Strassen_NN::run()
 
         double e_in = 0.0;
 
-        /// generate training and test data for current experiment
-        cube training_A(matrix_dimensions[0], matrix_dimensions[1], training_size, fill::randu);
-        cube training_B(matrix_dimensions[1], matrix_dimensions[2], training_size, fill::randu);
-        expand_data_range(training_A, training_B, 2.0);
+        if (expected_loss_steps > 0) {
+            /// no samples needed
+            e_in = train_expected_loss(expected_loss_steps);
+        } else if (training_data) {
+            /// run through a random subset of the shared samples
+            e_in = train_epoch(*training_data, randperm(training_data->size(), training_size));
+        } else {
+            /// generate training and test data for current experiment
+            cube training_A(matrix_dimensions[0], matrix_dimensions[1], training_size, fill::randu);
+            cube training_B(matrix_dimensions[1], matrix_dimensions[2], training_size, fill::randu);
+            expand_data_range(training_A, training_B, training_range);
+
+            /// run through entire training set
+            e_in = train_epoch(training_A, training_B);
+        }
 
-        /// run through entire training set
-        for(size_t j = 0; j < training_size; ++j) {
+        if ( polish_window > 0 && plateaued(i, e_in) ) {
+            polish(i);
+        }
 
-            e_in += forward_propagation(training_A.slice(j), training_B.slice(j));
-            backward_propagation();
-            update_weight_matrices();
+        if (prune_threshold > 0.0) {
+            prune_hidden_units();
         }
+        rank_history[i] = rank_estimate;
 
-        /// round all weights to nearest integer
-        W_1A = arma::round(W_1A);
-        W_1B = arma::round(W_1B);
-        W_2 = arma::round(W_2);
+        round_weights();
 
         /// in-sample error
-        in_sample_error[i] = e_in / training_size;
+        in_sample_error[i] = e_in;
         /// out-of-sample error
         out_sample_error[i] = test_out_of_sample();
 
         /// check whether current weight matrices should be saved
-       if ( (i > 0) && (out_sample_error[i] < threshold_error_out) && (out_sample_error[i] < out_sample_error[i-1]) ) {
+       if ( should_save(i) ) {
             /// save in-sample errors and weight matrices
             save_weights(i);
         }
@@ -268,6 +453,221 @@ void Strassen_NN::run()
 }
 
 
+/**
+
+    Pipelined schedule: while epoch i is trained, a helper thread
+    generates the data for epoch i+1 and another one evaluates (and
+    possibly saves) the rounded weights of epoch i-1.
+
+    The helpers use their own per-epoch random engines, so the data
+    differs from the sequential schedule, but it is reproducible
+    for a given seed.
+
+*/
+void Strassen_NN::run_pipelined()
+{
+    cube training_A;
+    cube training_B;
+    /// stream 2i for training data of epoch i, stream 2i+1 for its test data
+    const bool needs_samples = !training_data && (expected_loss_steps == 0);
+    if (needs_samples) {
+        generate_data(training_A, training_B, training_size, training_range, 0);
+    }
+
+    std::future<void> evaluation;
+
+    for (size_t i = 0; i < epochs; ++i) {
+
+        /// generate data for the next epoch while training on the current one
+        cube next_A;
+        cube next_B;
+        std::future<void> generation;
+        if ( (i + 1 < epochs) && needs_samples ) {
+            generation = std::async(std::launch::async, [&, i]() {
+                generate_data(next_A, next_B, training_size, training_range, 2*(i+1));
+            });
+        }
+
+        double e_in = 0.0;
+
+        if (expected_loss_steps > 0) {
+            e_in = train_expected_loss(expected_loss_steps);
+        } else if (training_data) {
+            e_in = train_epoch(*training_data, permutation(training_data->size(), training_size, 2*i));
+        } else {
+            e_in = train_epoch(training_A, training_B);
+        }
+
+        if ( polish_window > 0 && plateaued(i, e_in) ) {
+            polish(i);
+        }
+
+        if (prune_threshold > 0.0) {
+            prune_hidden_units();
+        }
+        rank_history[i] = rank_estimate;
+
+        round_weights();
+
+        /// in-sample error
+        in_sample_error[i] = e_in;
+
+        /// the save decision for epoch i depends on the out-of-sample error of epoch i-1
+        if (evaluation.valid()) {
+            evaluation.get();
+        }
+        /// evaluate an immutable snapshot of the rounded weights
+        evaluation = std::async(std::launch::async, &Strassen_NN::evaluate_snapshot, this, i, W_1A, W_1B, W_2);
+
+        if (generation.valid()) {
+            generation.get();
+            training_A = std::move(next_A);
+            training_B = std::move(next_B);
+        }
+    }
+
+    if (evaluation.valid()) {
+        evaluation.get();
+    }
+
+    /// save errors and final weights
+    save_data(epochs);
+}
+
+
+double Strassen_NN::train_epoch(const cube& A, const cube& B)
+{
+    if (batch_size > 0) {
+        return train_epoch_parallel(A.n_slices, [&](size_t j, Gradient& g) {
+            accumulate_gradient(A.slice(j), B.slice(j), A.slice(j) * B.slice(j), g);
+        });
+    }
+
+    double e_in = 0.0;
+
+    for(size_t j = 0; j < A.n_slices; ++j) {
+
+        e_in += forward_propagation(A.slice(j), B.slice(j));
+        backward_propagation();
+        update_weight_matrices();
+    }
+
+    return e_in / A.n_slices;
+}
+
+
+/**
+    the in-sample error improved by less than the relative tolerance over
+    the last polish_window epochs, and the last polishing is at least as long ago
+*/
+bool Strassen_NN::plateaued(size_t i, double e_in) const
+{
+    if ( (i < polish_window) || (i < last_polish + polish_window) ) {
+        return false;
+    }
+
+    const double e_in_before = in_sample_error[i - polish_window];
+
+    return (e_in_before - e_in) < polish_tolerance * e_in_before;
+}
+
+
+/**
+    second-order minimization of the Brent residual from the current weights,
+    rounding and evaluation of the epoch follow as usual
+*/
+void Strassen_NN::polish(size_t i)
+{
+    Levenberg_Marquardt lm(matrix_dimensions);
+    lm.polish(W_1A, W_1B, W_2, polish_iterations);
+
+    /// momentum of the first-order optimizer no longer matches
+    reset_optimizer_state();
+
+    tie_weights();
+
+    last_polish = i;
+}
+
+
+/**
+    round all weights to nearest integer
+*/
+void Strassen_NN::round_weights()
+{
+    if (tying) {
+        theta = arma::round(theta);
+        tying->expand(theta, W_1A, W_1B, W_2);
+        return;
+    }
+
+    W_1A = arma::round(W_1A);
+    W_1B = arma::round(W_1B);
+    W_2 = arma::round(W_2);
+}
+
+
+bool Strassen_NN::should_save(size_t i) const
+{
+    return (i > 0) && (out_sample_error[i] < threshold_error_out) && (out_sample_error[i] < out_sample_error[i-1]);
+}
+
+
+/**
+    uniformly distributed data from an engine owned by the calling thread
+*/
+void Strassen_NN::generate_data(cube& A, cube& B, size_t size, double scale, unsigned long long stream)
+{
+    std::seed_seq seed{ static_cast<unsigned long long>(seed_num), stream };
+    std::mt19937_64 engine(seed);
+    std::uniform_real_distribution<double> distribution(0.0, 1.0);
+
+    A.set_size(matrix_dimensions[0], matrix_dimensions[1], size);
+    B.set_size(matrix_dimensions[1], matrix_dimensions[2], size);
+
+    for (auto& a : A) { a = distribution(engine); }
+    for (auto& b : B) { b = distribution(engine); }
+
+    expand_data_range(A, B, scale);
+}
+
+
+/**
+    out-of-sample error of given weights, without touching the network state
+*/
+double Strassen_NN::evaluate(const mat& W1A, const mat& W1B, const mat& W2, const cube& A, const cube& B) const
+{
+    double e_out = 0.0;
+
+    for(size_t i = 0; i < A.n_slices; ++i) {
+
+        const vec x_1_i = (W1A * vectorise(A.slice(i))) % (W1B * vectorise(B.slice(i)));
+        const vec delta = W2 * x_1_i - vectorise( A.slice(i) * B.slice(i) );
+
+        e_out += dot(delta, delta);
+    }
+
+    return e_out / A.n_slices;
+}
+
+
+void Strassen_NN::evaluate_snapshot(size_t i, mat W1A, mat W1B, mat W2)
+{
+    if (test_data) {
+        out_sample_error[i] = evaluate(W1A, W1B, W2, *test_data, permutation(test_data->size(), test_size, 2*i+1));
+    } else {
+        cube test_A;
+        cube test_B;
+        generate_data(test_A, test_B, test_size, range_scale_factor, 2*i+1);
+
+        out_sample_error[i] = evaluate(W1A, W1B, W2, test_A, test_B);
+    }
+
+    if ( should_save(i) ) {
+        save_weights(i, W1A, W1B, W2);
+    }
+}
+
 
 
 
@@ -341,6 +741,10 @@ void Strassen_NN::run()
 */
 double Strassen_NN::test_out_of_sample()
 {
+    if (test_data) {
+        return evaluate(W_1A, W_1B, W_2, *test_data, randperm(test_data->size(), test_size));
+    }
+
     /// generate test data
     cube test_A(matrix_dimensions[0], matrix_dimensions[1], test_size, fill::randu);
     cube test_B(matrix_dimensions[1], matrix_dimensions[2], test_size, fill::randu);
@@ -354,3 +758,29 @@ double Strassen_NN::test_out_of_sample()
 
     return e_out / test_size;
 }
+
+
+
+/**
+
+    When training ends close to, but not at an exact solution,
+    search the integer neighbourhood of the rounded weights.
+    An exact result replaces the weights and is saved as "refined".
+
+*/
+bool Strassen_NN::refine(size_t max_iterations, int num_threads)
+{
+    Local_Search_Refiner refiner(matrix_dimensions, W_1A, W_1B, W_2, num_threads);
+
+    if ( !refiner.run(max_iterations) ) {
+        return false;
+    }
+
+    W_1A = refiner.get_W_1A();
+    W_1B = refiner.get_W_1B();
+    W_2 = refiner.get_W_2();
+
+    save_weights("refined", W_1A, W_1B, W_2);
+
+    return true;
+}
@@ -0,0 +1,106 @@
+#include <chrono>
+#include <algorithm>
+#include "Strassen_NN.h"
+#include "Worker_Pool.h"
+
+using namespace std;
+using namespace arma;
+
+
+
+
+/**
+    Synchronous data-parallel training: every mini-batch is split into
+    contiguous blocks, one per thread, whose gradients are summed in a
+    fixed-order tree before a single optimizer step. The result depends on
+    the number of threads, but not on scheduling, so runs are bitwise
+    reproducible for a given thread count.
+*/
+void Strassen_NN::set_data_parallel(int num_threads, size_t batch_size)
+{
+    this->batch_size = batch_size;
+
+    if (batch_size == 0) {
+        pool.reset();
+    } else if ( !pool || ( (num_threads > 0) && (pool->size() != num_threads) ) ) {
+        pool = std::make_shared<Worker_Pool>(num_threads);
+    }
+}
+
+
+/**
+    forward and backward pass with local buffers, the network state is not touched
+*/
+void Strassen_NN::accumulate_gradient(const mat& A, const mat& B, const mat& C, Gradient& g) const
+{
+    const vec x_a = vectorise(A);
+    const vec x_b = vectorise(B);
+
+    const vec s_a = W_1A * x_a;
+    const vec s_b = W_1B * x_b;
+    const vec x_h = s_a % s_b;
+
+    const vec delta = W_2 * x_h - vectorise(C);
+    const vec t = W_2.t() * delta;
+
+    g.dW_1A += (s_b % t) * x_a.t();
+    g.dW_1B += (s_a % t) * x_b.t();
+    g.dW_2 += delta * x_h.t();
+    g.loss += dot(delta, delta);
+}
+
+
+double Strassen_NN::train_epoch_parallel(size_t num_samples, const std::function<void(size_t, Gradient&)>& accumulate)
+{
+    const int num_threads = pool->size();
+
+    vector<Gradient> partial(num_threads);
+    double e_in = 0.0;
+
+    const auto start = chrono::steady_clock::now();
+
+    for (size_t first = 0; first < num_samples; first += batch_size) {
+
+        const size_t last = std::min(num_samples, first + batch_size);
+        const size_t chunk = (last - first + num_threads - 1) / num_threads;
+
+        /// thread-local partial gradients
+        pool->run([&](int t) {
+            Gradient& g = partial[t];
+            g.dW_1A.zeros(W_1A.n_rows, W_1A.n_cols);
+            g.dW_1B.zeros(W_1B.n_rows, W_1B.n_cols);
+            g.dW_2.zeros(W_2.n_rows, W_2.n_cols);
+            g.loss = 0.0;
+
+            const size_t begin = std::min(last, first + t*chunk);
+            const size_t end = std::min(last, begin + chunk);
+
+            for (size_t j = begin; j < end; ++j) {
+                accumulate(j, g);
+            }
+        });
+
+        /// tree reduction, partial[t] += partial[t + stride] in a fixed order
+        for (int stride = 1; stride < num_threads; stride *= 2) {
+            pool->run([&](int t) {
+                if ( (t % (2*stride) == 0) && (t + stride < num_threads) ) {
+                    partial[t].dW_1A += partial[t + stride].dW_1A;
+                    partial[t].dW_1B += partial[t + stride].dW_1B;
+                    partial[t].dW_2 += partial[t + stride].dW_2;
+                    partial[t].loss += partial[t + stride].loss;
+                }
+            });
+        }
+
+        e_in += partial[0].loss;
+
+        /// one step with the mean gradient of the mini-batch
+        const double scale = 1.0 / (last - first);
+        update_weight_matrices(scale * partial[0].dW_1A, scale * partial[0].dW_1B, scale * partial[0].dW_2);
+    }
+
+    const chrono::duration<double> elapsed = chrono::steady_clock::now() - start;
+    training_seconds += elapsed.count();
+
+    return e_in / num_samples;
+}
@@ -0,0 +1,111 @@
+#include <random>
+#include <numeric>
+#include <stdexcept>
+#include "Strassen_NN.h"
+#include "Shared_Dataset.h"
+
+using namespace std;
+using namespace arma;
+
+
+
+
+/**
+    Train and test on shared samples instead of generating new ones.
+    Every epoch draws a different subset of the samples in a different order.
+*/
+void Strassen_NN::set_datasets(std::shared_ptr<const Shared_Dataset> training, std::shared_ptr<const Shared_Dataset> test)
+{
+    if ( training && ( (training->get_matrix_dimensions() != matrix_dimensions) || (training->size() < training_size) ) ) {
+        throw invalid_argument("training dataset does not match matrix dimensions or training size");
+    }
+    if ( test && ( (test->get_matrix_dimensions() != matrix_dimensions) || (test->size() < test_size) ) ) {
+        throw invalid_argument("test dataset does not match matrix dimensions or test size");
+    }
+
+    training_data = training;
+    test_data = test;
+}
+
+
+/**
+    samples are used in place, without copying them out of the mapped file
+*/
+double Strassen_NN::train_epoch(const Shared_Dataset& data, const uvec& order)
+{
+    const int m = matrix_dimensions[0];
+    const int n = matrix_dimensions[1];
+    const int k = matrix_dimensions[2];
+
+    if (batch_size > 0) {
+        return train_epoch_parallel(order.n_elem, [&](size_t j, Gradient& g) {
+            double* sample = const_cast<double*>(data.sample(order[j]));
+            const mat A(sample, m, n, false, true);
+            const mat B(sample + m*n, n, k, false, true);
+            const mat C(sample + m*n + n*k, m, k, false, true);
+
+            accumulate_gradient(A, B, C, g);
+        });
+    }
+
+    double e_in = 0.0;
+
+    for (const uword j : order) {
+
+        double* sample = const_cast<double*>(data.sample(j));
+        const mat A(sample, m, n, false, true);
+        const mat B(sample + m*n, n, k, false, true);
+        const mat C(sample + m*n + n*k, m, k, false, true);
+
+        e_in += forward_propagation(A, B, C);
+        backward_propagation();
+        update_weight_matrices();
+    }
+
+    return e_in / order.n_elem;
+}
+
+
+double Strassen_NN::evaluate(const mat& W1A, const mat& W1B, const mat& W2, const Shared_Dataset& data, const uvec& order) const
+{
+    const int m = matrix_dimensions[0];
+    const int n = matrix_dimensions[1];
+    const int k = matrix_dimensions[2];
+
+    double e_out = 0.0;
+
+    for (const uword i : order) {
+
+        const double* sample = data.sample(i);
+        const vec a(const_cast<double*>(sample), m*n, false, true);
+        const vec b(const_cast<double*>(sample + m*n), n*k, false, true);
+        const vec c(const_cast<double*>(sample + m*n + n*k), m*k, false, true);
+
+        const vec delta = W2 * ((W1A * a) % (W1B * b)) - c;
+
+        e_out += dot(delta, delta);
+    }
+
+    return e_out / order.n_elem;
+}
+
+
+/**
+    first size elements of a random permutation of 0, ..., count-1,
+    from an engine owned by the calling thread
+*/
+uvec Strassen_NN::permutation(size_t count, size_t size, unsigned long long stream) const
+{
+    std::seed_seq seed{ static_cast<unsigned long long>(seed_num), stream };
+    std::mt19937_64 engine(seed);
+
+    uvec order(count);
+    std::iota(order.begin(), order.end(), 0);
+
+    for (size_t i = 0; i < size; ++i) {
+        std::uniform_int_distribution<size_t> pick(i, count-1);
+        std::swap(order[i], order[pick(engine)]);
+    }
+
+    return order.head(size);
+}
@@ -0,0 +1,70 @@
+#include "Strassen_NN.h"
+#include "Brent_Residual.h"
+
+using namespace std;
+using namespace arma;
+
+
+
+
+/**
+
+    For A, B with independent elements, uniformly distributed in [-s,s],
+    the output error is bilinear,
+
+        delta(c) = sum_{a,b} E(c,a,b) A(a) B(b),
+
+    with E the Brent residual. Since E[A(a) A(a')] = mu_2 [a == a'], mu_2 = s^2/3,
+    the expected loss is
+
+        E |delta|^2 = mu_2^2 sum_{c,a,b} E(c,a,b)^2,
+
+    i.e. no fourth moments are involved. The gradient is returned in the
+    same scaling as the sampled updates (delta * x^T, the factor 2 omitted).
+
+*/
+double Strassen_NN::expected_loss(mat& dW_1A, mat& dW_1B, mat& dW_2) const
+{
+    const double mu_2 = training_range*training_range / 3.0;
+    const double weight = mu_2*mu_2;
+
+    const cube E = Brent_Residual(matrix_dimensions, W_1A, W_1B, W_2).get_residual();
+
+    dW_1A.zeros(W_1A.n_rows, W_1A.n_cols);
+    dW_1B.zeros(W_1B.n_rows, W_1B.n_cols);
+    dW_2.zeros(W_2.n_rows, W_2.n_cols);
+
+    for (uword b = 0; b < E.n_slices; ++b) {
+
+        /// G(r,a) = sum_c W_2(c,r) E(c,a,b)
+        const mat G = W_2.t() * E.slice(b);
+
+        dW_1A += diagmat(W_1B.col(b)) * G;
+        dW_1B.col(b) = sum(G % W_1A, 1);
+        dW_2 += E.slice(b) * W_1A.t() * diagmat(W_1B.col(b));
+    }
+
+    dW_1A *= weight;
+    dW_1B *= weight;
+    dW_2 *= weight;
+
+    return weight * accu(square(E));
+}
+
+
+/**
+    full-batch steps on the expected loss, independent of the training size.
+    returns the expected loss before the last step
+*/
+double Strassen_NN::train_expected_loss(size_t steps)
+{
+    mat dW_1A, dW_1B, dW_2;
+    double e_in = 0.0;
+
+    for (size_t s = 0; s < steps; ++s) {
+        e_in = expected_loss(dW_1A, dW_1B, dW_2);
+        update_weight_matrices(dW_1A, dW_1B, dW_2);
+    }
+
+    return e_in;
+}
@@ -0,0 +1,89 @@
+#include <cmath>
+#include <algorithm>
+#include <stdexcept>
+#include "Strassen_NN.h"
+
+using namespace std;
+using namespace arma;
+
+
+
+
+/**
+    Start over-parameterised and let group sparsity switch off hidden units.
+    A unit is removed once its contribution |W_1A(r,:)| |W_1B(r,:)| |W_2(:,r)|
+    falls below the threshold, as long as more than min_rank units are left.
+*/
+void Strassen_NN::set_rank_annealing(double group_sparsity, double prune_threshold, int min_rank)
+{
+    if ( tying && ( (group_sparsity > 0.0) || (prune_threshold > 0.0) ) ) {
+        throw invalid_argument("rank annealing is not available for symmetric weights");
+    }
+
+    this->group_sparsity = group_sparsity;
+    this->prune_threshold = prune_threshold;
+    this->min_rank = min_rank;
+}
+
+
+/**
+    proximal step of the group lasso penalty  sum_r |(W_1A(r,:), W_1B(r,:), W_2(:,r))|
+*/
+void Strassen_NN::shrink_hidden_units()
+{
+    for (uword r = 0; r < W_2.n_cols; ++r) {
+
+        const double norm = std::sqrt( accu(square(W_1A.row(r))) + accu(square(W_1B.row(r))) + accu(square(W_2.col(r))) );
+        const double factor = (norm > 0.0) ? std::max(0.0, 1.0 - learning_rate*group_sparsity/norm) : 0.0;
+
+        W_1A.row(r) *= factor;
+        W_1B.row(r) *= factor;
+        W_2.col(r) *= factor;
+    }
+}
+
+
+int Strassen_NN::prune_hidden_units()
+{
+    int pruned = 0;
+
+    for (uword r = W_2.n_cols; r-- > 0; ) {
+
+        if (rank_estimate <= min_rank) {
+            break;
+        }
+
+        const double contribution = norm(W_1A.row(r)) * norm(W_1B.row(r)) * norm(W_2.col(r));
+
+        if (contribution < prune_threshold) {
+            remove_hidden_unit(r);
+            ++pruned;
+        }
+    }
+
+    return pruned;
+}
+
+
+/**
+    shrink all buffers of the hidden layer in place, including the optimizer state
+*/
+void Strassen_NN::remove_hidden_unit(uword r)
+{
+    W_1A.shed_row(r);
+    W_1B.shed_row(r);
+    W_2.shed_col(r);
+
+    v_dW_1A.shed_row(r); S_dW_1A.shed_row(r);
+    v_dW_1B.shed_row(r); S_dW_1B.shed_row(r);
+    v_dW_2.shed_col(r); S_dW_2.shed_col(r);
+
+    x_1.shed_row(r);
+    s_1A.shed_row(r);
+    s_1B.shed_row(r);
+    temp.shed_row(r);
+    delta_1A.shed_row(r);
+    delta_1B.shed_row(r);
+
+    --rank_estimate;
+}
@@ -0,0 +1,54 @@
+#include <stdexcept>
+#include "Strassen_NN.h"
+#include "Weight_Tying.h"
+
+using namespace std;
+using namespace arma;
+
+
+
+
+/**
+    Restrict training to weights invariant under the given symmetry,
+    starting from the symmetric weights closest to the current ones.
+*/
+void Strassen_NN::set_symmetry(const string& symmetry, int num_invariant)
+{
+    const Weight_Tying::Symmetry s = Weight_Tying::parse(symmetry);
+
+    if (s == Weight_Tying::none) {
+        tying.reset();
+        return;
+    }
+
+    if ( (group_sparsity > 0.0) || (prune_threshold > 0.0) ) {
+        throw invalid_argument("symmetric weights are not available with rank annealing");
+    }
+
+    tying = std::make_shared<Weight_Tying>(matrix_dimensions, rank_estimate, s, num_invariant);
+    tie_weights();
+}
+
+
+void Strassen_NN::tie_weights()
+{
+    if ( !tying ) { return; }
+
+    theta = tying->project(W_1A, W_1B, W_2);
+    v_d_theta = vec(theta.n_elem, fill::zeros);
+
+    tying->expand(theta, W_1A, W_1B, W_2);
+}
+
+
+/**
+    momentum on the shared parameters of symmetric weights,
+    the gradient of each weight is accumulated into its parameter
+*/
+void Strassen_NN::update_tied_weights(const vec& d_theta)
+{
+    v_d_theta = beta_1 * v_d_theta + learning_rate * d_theta;
+    theta -= v_d_theta + weight_decay_factor * theta;
+
+    tying->expand(theta, W_1A, W_1B, W_2);
+}
@@ -60,6 +60,8 @@ void Strassen_NN::save_data(int n)
 
 void Strassen_NN::save_info() const
 {
+    if ( instance_path.empty() ) { return; }
+
     const string file_path = instance_path +  "data_info.txt";
 
     ofstream data_info;
@@ -80,23 +82,44 @@ void Strassen_NN::save_info() const
 
 void Strassen_NN::save_errors() const
 {
+    if ( instance_path.empty() ) { return; }
+
     const string in_error_file_name = instance_path + "in_sample_error.dat";
     in_sample_error.save(in_error_file_name, raw_ascii);
 
     const string out_error_file_name = instance_path + "out_sample_error.dat";
     out_sample_error.save(out_error_file_name, raw_ascii);
+
+    if (prune_threshold > 0.0) {
+        const string rank_file_name = instance_path + "rank.dat";
+        rank_history.save(rank_file_name, raw_ascii);
+    }
 }
 
 
 void Strassen_NN::save_weights(int n)
 {
-    const string file_name1A = instance_path + "W1A_epoch" + to_string(n) + ".dat";
-    const string file_name1B = instance_path + "W1B_epoch" + to_string(n) + ".dat";
-    const string file_name2 = instance_path + "W2_epoch" + to_string(n) + ".dat";
+    save_weights(n, W_1A, W_1B, W_2);
+}
+
+
+void Strassen_NN::save_weights(int n, const mat& W1A, const mat& W1B, const mat& W2) const
+{
+    save_weights("epoch" + to_string(n), W1A, W1B, W2);
+}
+
+
+void Strassen_NN::save_weights(const string& tag, const mat& W1A, const mat& W1B, const mat& W2) const
+{
+    if ( instance_path.empty() ) { return; }
+
+    const string file_name1A = instance_path + "W1A_" + tag + ".dat";
+    const string file_name1B = instance_path + "W1B_" + tag + ".dat";
+    const string file_name2 = instance_path + "W2_" + tag + ".dat";
 
-    W_1A.save(file_name1A, raw_ascii);
-    W_1B.save(file_name1B, raw_ascii);
-    W_2.save(file_name2, raw_ascii);
+    W1A.save(file_name1A, raw_ascii);
+    W1B.save(file_name1B, raw_ascii);
+    W2.save(file_name2, raw_ascii);
 }
 
 
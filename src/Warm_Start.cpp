@@ -0,0 +1,360 @@
+#include <cmath>
+#include <numeric>
+#include <algorithm>
+#include <stdexcept>
+#include "Warm_Start.h"
+#include "Brent_Residual.h"
+
+using namespace std;
+using namespace arma;
+
+
+namespace
+{
+    /**
+        Rows: products r = r1*R2 + r2. Columns: elements of a (p1 p2)*(q1 q2) matrix
+        in block form, X((i1,i2),(j1,j2)) with outer block index (i1,j1) from the
+        first and inner index (i2,j2) from the second factor. Only nonzero
+        coefficients are multiplied.
+    */
+    mat kronecker_factor(const mat& F_1, uword p_1, const mat& F_2, uword p_2)
+    {
+        const sp_mat S_1(F_1);
+        const sp_mat S_2(F_2);
+
+        const uword p = p_1*p_2;
+
+        umat locations(2, S_1.n_nonzero * S_2.n_nonzero);
+        vec values(S_1.n_nonzero * S_2.n_nonzero);
+
+        uword q = 0;
+        for (sp_mat::const_iterator it_1 = S_1.begin(); it_1 != S_1.end(); ++it_1) {
+
+            const uword i_1 = it_1.col() % p_1;
+            const uword j_1 = it_1.col() / p_1;
+
+            for (sp_mat::const_iterator it_2 = S_2.begin(); it_2 != S_2.end(); ++it_2, ++q) {
+
+                const uword i_2 = it_2.col() % p_2;
+                const uword j_2 = it_2.col() / p_2;
+
+                locations(0, q) = it_1.row() * F_2.n_rows + it_2.row();
+                locations(1, q) = (i_1*p_2 + i_2) + p*(j_1*(F_2.n_cols/p_2) + j_2);
+                values[q] = (*it_1) * (*it_2);
+            }
+        }
+
+        return mat(sp_mat(locations, values, F_1.n_rows*F_2.n_rows, F_1.n_cols*F_2.n_cols));
+    }
+}
+
+
+
+
+Warm_Start::Warm_Start(const vector<int>& matrix_dimensions,
+                       const mat& W_1A,
+                       const mat& W_1B,
+                       const mat& W_2,
+                       unsigned long long seed)
+
+:   matrix_dimensions(matrix_dimensions),
+    W_1A(W_1A),
+    W_1B(W_1B),
+    W_2(W_2),
+    engine(seed)
+
+{
+    const uword m = matrix_dimensions[0];
+    const uword n = matrix_dimensions[1];
+    const uword k = matrix_dimensions[2];
+
+    if ( (W_1A.n_cols != m*n) || (W_1B.n_cols != n*k) || (W_2.n_rows != m*k) ||
+         (W_1B.n_rows != W_1A.n_rows) || (W_2.n_cols != W_1A.n_rows) ) {
+        throw invalid_argument("weight matrices do not match matrix dimensions");
+    }
+}
+
+
+/**
+    the matrix dimensions follow from the shapes of the weight matrices,
+    (mn)(mk)/(nk) = m^2
+*/
+Warm_Start Warm_Start::load(const string& path, const string& tag, unsigned long long seed)
+{
+    mat W_1A, W_1B, W_2;
+
+    if ( !W_1A.load(path + "W1A_" + tag + ".dat", raw_ascii) ||
+         !W_1B.load(path + "W1B_" + tag + ".dat", raw_ascii) ||
+         !W_2.load(path + "W2_" + tag + ".dat", raw_ascii) ) {
+        throw runtime_error("could not load weights '" + tag + "' from " + path);
+    }
+
+    const double mn = W_1A.n_cols;
+    const double nk = W_1B.n_cols;
+    const double mk = W_2.n_rows;
+
+    const int m = std::lround(std::sqrt(mn*mk/nk));
+    const int n = (m > 0) ? std::lround(mn/m) : 0;
+    const int k = (m > 0) ? std::lround(mk/m) : 0;
+
+    return Warm_Start({m, n, k}, W_1A, W_1B, W_2, seed);
+}
+
+
+/**
+    Block matrices A = (A_1 blocks of A_2 size) multiply as the outer scheme,
+    with every block product computed by the inner scheme. The tensor of the
+    composition is the Kronecker product of both tensors, so exact schemes
+    compose to an exact scheme.
+*/
+Warm_Start Warm_Start::kronecker(const Warm_Start& first, const Warm_Start& second)
+{
+    const vector<int>& d_1 = first.matrix_dimensions;
+    const vector<int>& d_2 = second.matrix_dimensions;
+
+    const vector<int> matrix_dimensions = { d_1[0]*d_2[0], d_1[1]*d_2[1], d_1[2]*d_2[2] };
+
+    /// W_2 is composed row-wise over products, i.e. as transpose
+    const mat W_1A = kronecker_factor(first.W_1A, d_1[0], second.W_1A, d_2[0]);
+    const mat W_1B = kronecker_factor(first.W_1B, d_1[1], second.W_1B, d_2[1]);
+    const mat W_2 = kronecker_factor(first.W_2.t(), d_1[0], second.W_2.t(), d_2[0]).t();
+
+    return Warm_Start(matrix_dimensions, W_1A, W_1B, W_2);
+}
+
+
+bool Warm_Start::is_exact() const
+{
+    return Brent_Residual(matrix_dimensions, W_1A, W_1B, W_2).is_exact();
+}
+
+
+void Warm_Start::save(const string& path, const string& tag) const
+{
+    if ( !W_1A.save(path + "W1A_" + tag + ".dat", raw_ascii) ||
+         !W_1B.save(path + "W1B_" + tag + ".dat", raw_ascii) ||
+         !W_2.save(path + "W2_" + tag + ".dat", raw_ascii) ) {
+        throw runtime_error("could not save weights '" + tag + "' to " + path);
+    }
+}
+
+
+void Warm_Start::set_seed(unsigned long long seed)
+{
+    engine.seed(seed);
+}
+
+
+void Warm_Start::add_noise(double standard_deviation)
+{
+    normal_distribution<double> noise(0.0, standard_deviation);
+
+    for (auto& w : W_1A) { w += noise(engine); }
+    for (auto& w : W_1B) { w += noise(engine); }
+    for (auto& w : W_2) { w += noise(engine); }
+}
+
+
+/**
+    set coefficients, each with given probability, to a different value in {-1,0,1}
+*/
+void Warm_Start::flip_coefficients(double probability)
+{
+    bernoulli_distribution flip(probability);
+    uniform_int_distribution<int> shift(1, 2);
+
+    auto flip_matrix = [&](mat& W) {
+        for (auto& w : W) {
+            if (flip(engine)) {
+                const double c = std::max(-1.0, std::min(1.0, std::round(w)));
+                w = std::fmod(c + 1 + shift(engine), 3.0) - 1;
+            }
+        }
+    };
+
+    flip_matrix(W_1A);
+    flip_matrix(W_1B);
+    flip_matrix(W_2);
+}
+
+
+/**
+    the order of the products is arbitrary
+*/
+void Warm_Start::permute_products()
+{
+    uvec order(W_1A.n_rows);
+    std::iota(order.begin(), order.end(), 0);
+    std::shuffle(order.begin(), order.end(), engine);
+
+    W_1A = W_1A.rows(order);
+    W_1B = W_1B.rows(order);
+    W_2 = W_2.cols(order);
+}
+
+
+/**
+    (a.x)(b.y) w = (-a.x)(b.y) (-w) = (a.x)(-b.y) (-w)
+*/
+void Warm_Start::flip_signs()
+{
+    bernoulli_distribution flip(0.5);
+
+    for (uword r = 0; r < W_1A.n_rows; ++r) {
+        const double s_A = flip(engine) ? -1.0 : 1.0;
+        const double s_B = flip(engine) ? -1.0 : 1.0;
+
+        W_1A.row(r) *= s_A;
+        W_1B.row(r) *= s_B;
+        W_2.col(r) *= s_A*s_B;
+    }
+}
+
+
+/**
+    A B = C  <=>  (P A Q^-1) (Q B R^-1) = P C R^-1
+
+    for invertible P (m*m), Q (n*n), R (k*k). Using vec(X Y Z) = (Z^T kron X) vec(Y),
+    a scheme for (A,B) becomes a scheme for (P A Q^-1, Q B R^-1).
+*/
+void Warm_Start::transform(const mat& P, const mat& Q, const mat& R)
+{
+    W_1A = W_1A * kron(Q.t(), inv(P));
+    W_1B = W_1B * kron(R.t(), inv(Q));
+    W_2 = kron(inv(R).t(), P) * W_2;
+}
+
+
+/**
+    signed permutations keep integer coefficients integer
+*/
+void Warm_Start::random_transform()
+{
+    const mat P = random_signed_permutation(matrix_dimensions[0]);
+    const mat Q = random_signed_permutation(matrix_dimensions[1]);
+    const mat R = random_signed_permutation(matrix_dimensions[2]);
+
+    transform(P, Q, R);
+    permute_products();
+    flip_signs();
+}
+
+
+/**
+    (A B)^T = B^T A^T  turns a scheme for <m,n,k> into one for <k,n,m>
+*/
+void Warm_Start::transpose()
+{
+    const int m = matrix_dimensions[0];
+    const int n = matrix_dimensions[1];
+    const int k = matrix_dimensions[2];
+
+    mat W_1A_t(W_1A.n_rows, k*n);
+    mat W_1B_t(W_1A.n_rows, n*m);
+    mat W_2_t(k*m, W_1A.n_rows);
+
+    for (int i = 0; i < m; ++i) {
+        for (int j = 0; j < n; ++j) {
+            W_1B_t.col(j + n*i) = W_1A.col(i + m*j);
+        }
+    }
+    for (int j = 0; j < n; ++j) {
+        for (int l = 0; l < k; ++l) {
+            W_1A_t.col(l + k*j) = W_1B.col(j + n*l);
+        }
+    }
+    for (int i = 0; i < m; ++i) {
+        for (int l = 0; l < k; ++l) {
+            W_2_t.row(l + k*i) = W_2.row(i + m*l);
+        }
+    }
+
+    matrix_dimensions = {k, n, m};
+    W_1A = W_1A_t;
+    W_1B = W_1B_t;
+    W_2 = W_2_t;
+}
+
+
+/**
+    Embed A (m*n), B (n*k) in the upper left corners of larger matrices.
+    The existing products cover all terms A(i,j) B(j,l) with i < m, j < n, l < k,
+    the remaining terms are computed by the standard algorithm,
+    e.g. <2,2,2;7> -> <2,2,3;11>.
+*/
+void Warm_Start::extend(const vector<int>& new_dimensions)
+{
+    const int m = matrix_dimensions[0];
+    const int n = matrix_dimensions[1];
+    const int k = matrix_dimensions[2];
+
+    const int M = new_dimensions[0];
+    const int N = new_dimensions[1];
+    const int K = new_dimensions[2];
+
+    if ( (M < m) || (N < n) || (K < k) ) {
+        throw invalid_argument("cannot extend a scheme to smaller matrix dimensions");
+    }
+
+    const int rank = W_1A.n_rows;
+    const int new_rank = rank + M*N*K - m*n*k;
+
+    mat W_1A_e(new_rank, M*N, fill::zeros);
+    mat W_1B_e(new_rank, N*K, fill::zeros);
+    mat W_2_e(M*K, new_rank, fill::zeros);
+
+    /// existing products
+    for (int i = 0; i < m; ++i) {
+        for (int j = 0; j < n; ++j) {
+            W_1A_e.submat(0, i + M*j, rank-1, i + M*j) = W_1A.col(i + m*j);
+        }
+    }
+    for (int j = 0; j < n; ++j) {
+        for (int l = 0; l < k; ++l) {
+            W_1B_e.submat(0, j + N*l, rank-1, j + N*l) = W_1B.col(j + n*l);
+        }
+    }
+    for (int i = 0; i < m; ++i) {
+        for (int l = 0; l < k; ++l) {
+            W_2_e.submat(i + M*l, 0, i + M*l, rank-1) = W_2.row(i + m*l);
+        }
+    }
+
+    /// standard algorithm for the remaining terms
+    int r = rank;
+    for (int i = 0; i < M; ++i) {
+        for (int j = 0; j < N; ++j) {
+            for (int l = 0; l < K; ++l) {
+
+                if ( (i < m) && (j < n) && (l < k) ) { continue; }
+
+                W_1A_e(r, i + M*j) = 1;
+                W_1B_e(r, j + N*l) = 1;
+                W_2_e(i + M*l, r) = 1;
+                ++r;
+            }
+        }
+    }
+
+    matrix_dimensions = new_dimensions;
+    W_1A = W_1A_e;
+    W_1B = W_1B_e;
+    W_2 = W_2_e;
+}
+
+
+mat Warm_Start::random_signed_permutation(int size)
+{
+    vector<int> order(size);
+    std::iota(order.begin(), order.end(), 0);
+    std::shuffle(order.begin(), order.end(), engine);
+
+    bernoulli_distribution flip(0.5);
+
+    mat P(size, size, fill::zeros);
+    for (int i = 0; i < size; ++i) {
+        P(i, order[i]) = flip(engine) ? -1.0 : 1.0;
+    }
+
+    return P;
+}
@@ -0,0 +1,186 @@
+#include <stdexcept>
+#include <algorithm>
+#include "Weight_Tying.h"
+
+using namespace std;
+using namespace arma;
+
+
+
+
+Weight_Tying::Weight_Tying(const vector<int>& matrix_dimensions,
+                           int rank,
+                           Symmetry symmetry,
+                           int num_invariant)
+
+:   n(matrix_dimensions[0]),
+    rank(rank),
+    parameter_1A(rank*n*n),
+    parameter_1B(rank*n*n),
+    parameter_2(n*n*rank)
+
+{
+    const bool square = (matrix_dimensions[0] == matrix_dimensions[1]) && (matrix_dimensions[1] == matrix_dimensions[2]);
+    if ( (symmetry == none) || !square ) {
+        throw invalid_argument("symmetric weights require a symmetry and square matrices");
+    }
+
+    const int orbit_size = (symmetry == cyclic) ? 3 : 2;
+    if (num_invariant < 0) {
+        num_invariant = rank % orbit_size;
+    }
+    if ( (num_invariant > rank) || ((rank - num_invariant) % orbit_size != 0) ) {
+        throw invalid_argument("rank " + to_string(rank) + " does not split into " + to_string(num_invariant) +
+                               " invariant products and orbits of size " + to_string(orbit_size));
+    }
+
+    int r = 0;
+
+    /// invariant products
+    for (int s = 0; s < num_invariant; ++s, ++r) {
+        if (symmetry == cyclic) {
+            const Block p = new_block();
+            add_product(r, p, false, p, false, p, false);
+        } else {
+            const Block u = new_block();
+            const Block v = new_block(true);
+            add_product(r, u, false, v, false, u, true);
+        }
+    }
+
+    /// orbits
+    while (r < rank) {
+        const Block u = new_block();
+        const Block v = new_block();
+        const Block w = new_block();
+
+        add_product(r++, u, false, v, false, w, false);
+
+        if (symmetry == cyclic) {
+            add_product(r++, v, false, w, false, u, false);
+            add_product(r++, w, false, u, false, v, false);
+        } else {
+            add_product(r++, w, true, v, true, u, true);
+        }
+    }
+
+    multiplicity = vec(num_params, fill::zeros);
+    for (auto q : parameter_1A) { multiplicity[q] += 1; }
+    for (auto q : parameter_1B) { multiplicity[q] += 1; }
+    for (auto q : parameter_2) { multiplicity[q] += 1; }
+}
+
+
+Weight_Tying::Symmetry Weight_Tying::parse(const string& name)
+{
+    if (name == "none") { return none; }
+    if (name == "cyclic" || name == "z3") { return cyclic; }
+    if (name == "transpose") { return transpose; }
+
+    throw invalid_argument("unknown symmetry '" + name + "'");
+}
+
+
+Weight_Tying::Block Weight_Tying::new_block(bool symmetric)
+{
+    const Block block { num_params, symmetric };
+    num_params += symmetric ? n*(n+1)/2 : n*n;
+    return block;
+}
+
+
+/**
+    parameter of the linear form at matrix element index = p + n*q,
+    or at (q,p) if transposed
+*/
+size_t Weight_Tying::parameter(const Block& block, uword index, bool transposed) const
+{
+    uword p = index % n;
+    uword q = index / n;
+
+    if (transposed) { std::swap(p, q); }
+
+    if (block.symmetric) {
+        if (p > q) { std::swap(p, q); }
+        /// upper triangle, column by column
+        return block.offset + q*(q+1)/2 + p;
+    }
+
+    return block.offset + p + n*q;
+}
+
+
+void Weight_Tying::add_product(int r, const Block& u, bool u_t, const Block& v, bool v_t, const Block& w, bool w_t)
+{
+    const uword n_2 = n*n;
+
+    for (uword x = 0; x < n_2; ++x) {
+        /// W_1A(r,a), W_1B(r,b), column-major
+        parameter_1A[r + rank*x] = parameter(u, x, u_t);
+        parameter_1B[r + rank*x] = parameter(v, x, v_t);
+
+        /// W_2(c,r) = w at X(l,i) for c = (i,l)
+        parameter_2[x + n_2*r] = parameter(w, x, !w_t);
+    }
+}
+
+
+void Weight_Tying::expand(const vec& theta, mat& W_1A, mat& W_1B, mat& W_2) const
+{
+    const uword n_2 = n*n;
+
+    W_1A.set_size(rank, n_2);
+    W_1B.set_size(rank, n_2);
+    W_2.set_size(n_2, rank);
+
+    for (uword k = 0; k < parameter_1A.n_elem; ++k) {
+        W_1A[k] = theta[parameter_1A[k]];
+        W_1B[k] = theta[parameter_1B[k]];
+        W_2[k] = theta[parameter_2[k]];
+    }
+}
+
+
+vec Weight_Tying::gradient(const mat& dW_1A, const mat& dW_1B, const mat& dW_2) const
+{
+    vec d_theta(num_params, fill::zeros);
+
+    for (uword k = 0; k < parameter_1A.n_elem; ++k) {
+        d_theta[parameter_1A[k]] += dW_1A[k];
+        d_theta[parameter_1B[k]] += dW_1B[k];
+        d_theta[parameter_2[k]] += dW_2[k];
+    }
+
+    return d_theta;
+}
+
+
+vec Weight_Tying::gradient(const vec& delta_1A, const vec& x_0A,
+                           const vec& delta_1B, const vec& x_0B,
+                           const vec& delta_2, const vec& x_1) const
+{
+    const uword n_2 = n*n;
+
+    vec d_theta(num_params, fill::zeros);
+
+    for (uword x = 0; x < n_2; ++x) {
+        for (uword r = 0; r < static_cast<uword>(rank); ++r) {
+            d_theta[parameter_1A[r + rank*x]] += delta_1A[r] * x_0A[x];
+            d_theta[parameter_1B[r + rank*x]] += delta_1B[r] * x_0B[x];
+        }
+    }
+
+    for (uword r = 0; r < static_cast<uword>(rank); ++r) {
+        for (uword c = 0; c < n_2; ++c) {
+            d_theta[parameter_2[c + n_2*r]] += delta_2[c] * x_1[r];
+        }
+    }
+
+    return d_theta;
+}
+
+
+vec Weight_Tying::project(const mat& W_1A, const mat& W_1B, const mat& W_2) const
+{
+    return gradient(W_1A, W_1B, W_2) / multiplicity;
+}
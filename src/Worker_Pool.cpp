@@ -0,0 +1,103 @@
+#include <algorithm>
+#include <exception>
+#include "Worker_Pool.h"
+
+using namespace std;
+
+
+
+
+Worker_Pool::Worker_Pool(int num_threads)
+
+:   num_threads(num_threads > 0 ? num_threads : max(1u, thread::hardware_concurrency()))
+
+{
+    for (int t = 1; t < this->num_threads; ++t) {
+        threads.emplace_back(&Worker_Pool::work, this, t);
+    }
+}
+
+
+Worker_Pool::~Worker_Pool()
+{
+    {
+        lock_guard<mutex> lock(pool_mutex);
+        stopping = true;
+    }
+    task_ready.notify_all();
+
+    for (auto& t : threads) {
+        t.join();
+    }
+}
+
+
+void Worker_Pool::run(const function<void(int)>& f)
+{
+    {
+        lock_guard<mutex> lock(pool_mutex);
+        task = &f;
+        pending = num_threads - 1;
+        ++generation;
+    }
+    task_ready.notify_all();
+
+    /// the other threads still use the task, so wait for them before rethrowing
+    exception_ptr error;
+    try {
+        f(0);
+    } catch (...) {
+        error = current_exception();
+    }
+
+    unique_lock<mutex> lock(pool_mutex);
+    task_done.wait(lock, [this]() { return pending == 0; });
+    task = nullptr;
+
+    if ( !error ) {
+        error = worker_error;
+    }
+    worker_error = nullptr;
+
+    if (error) {
+        rethrow_exception(error);
+    }
+}
+
+
+void Worker_Pool::work(int t)
+{
+    size_t seen = 0;
+
+    while (true) {
+
+        const function<void(int)>* f;
+        {
+            unique_lock<mutex> lock(pool_mutex);
+            task_ready.wait(lock, [this, seen]() { return stopping || (generation != seen); });
+
+            if (stopping) {
+                return;
+            }
+
+            seen = generation;
+            f = task;
+        }
+
+        exception_ptr error;
+        try {
+            (*f)(t);
+        } catch (...) {
+            error = current_exception();
+        }
+
+        {
+            lock_guard<mutex> lock(pool_mutex);
+            if ( error && !worker_error ) {
+                worker_error = error;
+            }
+            --pending;
+        }
+        task_done.notify_one();
+    }
+}
@@ -0,0 +1,73 @@
+#include <iostream>
+#include <string>
+#include <thread>
+#include <cstdlib>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+
+using namespace std;
+
+
+/**
+    Minimal client for 'snn --serve <socket path>'.
+
+    Sends the JSON job lines read from stdin to the server and prints
+    the result lines as they arrive, until all jobs are answered.
+
+        snn_client /tmp/snn.sock < jobs.jsonl
+*/
+int main(int argc, char* argv[])
+{
+    if (argc != 2) {
+        cerr << "usage: snn_client <socket path> < jobs.jsonl" << endl;
+        return EXIT_FAILURE;
+    }
+
+    const string socket_path = argv[1];
+
+    sockaddr_un address = {};
+    address.sun_family = AF_UNIX;
+    if (socket_path.size() >= sizeof(address.sun_path)) {
+        cerr << "socket path too long" << endl;
+        return EXIT_FAILURE;
+    }
+    socket_path.copy(address.sun_path, socket_path.size());
+
+    const int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if ( (fd < 0) || (connect(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) < 0) ) {
+        cerr << "cannot connect to " << socket_path << endl;
+        return EXIT_FAILURE;
+    }
+
+    /// print results while jobs are still being sent
+    thread receiver([fd]() {
+        char buffer[4096];
+        ssize_t n;
+        while ( (n = recv(fd, buffer, sizeof(buffer), 0)) > 0 ) {
+            cout.write(buffer, n);
+            cout.flush();
+        }
+    });
+
+    string line;
+    while (getline(cin, line)) {
+        line += "\n";
+
+        size_t sent = 0;
+        while (sent < line.size()) {
+            const ssize_t n = send(fd, line.data() + sent, line.size() - sent, MSG_NOSIGNAL);
+            if (n <= 0) { break; }
+            sent += n;
+        }
+    }
+
+    /// no more jobs, the server closes the connection after the last result
+    shutdown(fd, SHUT_WR);
+
+    receiver.join();
+    close(fd);
+
+    return 0;
+}